@@ -20,18 +20,38 @@
  */
 
 /*
- * IMPORTANT: you must compile with default short ints because the
- * STinG & USB APIs expect this ...
+ * NOTE: the STinG & USB APIs expect 16-bit ints, but all structures and
+ * prototypes shared with them use the explicit-width types from transprt.h,
+ * so this compiles with -mshort (as required for the Atari build) and also
+ * natively on 32/64-bit hosts.
  */
-#if __SIZEOF_INT__ != 2
-# error you must compile with short ints!
-#endif
 
 #include <string.h>
 
 #include "arpcache.h"   /* application-specific */
 
-#define ARP_NUM     61  /* # of ARP cache entries, prime for better hashing */
+/*
+ * the number of ARP cache entries is set at load time by arp_setup(); it
+ * is always a prime, for better hashing
+ */
+#define ARP_MIN     5   /* min # of ARP cache entries */
+#define ARP_MAX     4093/* max # of ARP cache entries */
+#define ARP_PROBE   8   /* max entries examined for any one address */
+#define ARP_SWEEP   8   /* entries examined per call to arp_refresh() */
+
+#define ARP_LIFETIME_MS 600000L /* unpinned entries expire 10 minutes after last confirmed */
+#define ARP_REFRESH_MS  540000L /* entries in use are refreshed 1 minute before that */
+
+/*
+ *  hash functions: these fold all four bytes of the address, since the
+ *  low byte alone is often shared by hosts on different subnets.  the
+ *  probe sequence for an address starts at HASH() and steps by STEP()
+ *  (double hashing), which avoids the clustering of linear probing; since
+ *  arp_num is prime, the sequence can reach every entry.
+ */
+#define FOLD(ip)    ((uint16)((ip)>>16) ^ (uint16)(ip))
+#define HASH(ip)    ((int16)(FOLD(ip) % arp_num))
+#define STEP(ip)    ((int16)(1 + FOLD(ip) % (arp_num-2)))
 
 /*
  *  ARP cache entry
@@ -40,79 +60,273 @@ typedef struct arp_entry
 {
     uint32 ip_addr;             /* IP address */
     char   ether[ETH_ALEN];     /* EtherNet station address */
-    uint16 used;                /* flag to signal in use */
+    uint16 used;                /* flags, see below (0 => entry has never been used) */
+#define ARP_USED        0x0001
+#define ARP_PINNED      0x0002  /* never evicted or expired */
+#define ARP_REFERENCED  0x0004  /* looked up since last confirmed */
+#define ARP_REFRESHING  0x0008  /* refresh has been requested */
+#define ARP_DELETED     0x0010  /* tombstone: lookups must probe past this entry */
+    int32  confirmed;           /* TIMER_now() when entry was last entered/updated */
+    uint32 last_used;           /* value of use_count when last looked up (for LRU) */
 } ARP_ENTRY;
 
-static ARP_ENTRY arpEntries[ARP_NUM];
+/*
+ *  the cache is an open-addressed hash table.  an address is always
+ *  within the first ARP_PROBE entries of its probe sequence, so a lookup
+ *  never examines more than ARP_PROBE entries, and stops early at an
+ *  entry that has never been used.  deleted entries become tombstones,
+ *  which are reused by arp_enter().
+ *
+ *  we also remember the last entry found, since most traffic goes to
+ *  one next hop (the gateway).
+ */
+static ARP_ENTRY fallback[ARP_MIN];     /* used if allocation fails */
+static ARP_ENTRY *arpEntries = fallback;
+static int16 arp_num = ARP_MIN;
+static ARP_ENTRY *last_hit;     /* most recently found entry */
+static uint32 use_count;        /* incremented on each lookup */
+static int16 sweep;             /* next entry to check in arp_refresh() */
+
+int32 arp_expired;              /* instrumentation */
+int32 arp_evicted;
+int32 arp_lookups;
+int32 arp_fast_hits;            /* lookups satisfied by last_hit */
+int32 arp_probes;               /* entries examined by other lookups */
 
 /* function prototypes */
+static ARP_ENTRY *lookup(uint32 ip_addr,int16 count);
 static void update(ARP_ENTRY *arp,uint32 ip,char *mac);
 
 
+/*
+ *  allocate & initialise the cache, using the supplied allocation
+ *  function.  the number of entries is rounded up to a prime.
+ *      returns number of entries
+ */
+int16 arp_setup(int16 entries,void *(*alloc)(long size))
+{
+    ARP_ENTRY *p;
+    int16 i;
+
+    if (entries < ARP_MIN)
+        entries = ARP_MIN;
+    if (entries > ARP_MAX)
+        entries = ARP_MAX;
+
+    for ( ; ; entries++)        /* round up to a prime */
+    {
+        for (i = 2; i*i <= entries; i++)
+            if (entries % i == 0)
+                break;
+        if (i*i > entries)
+            break;
+    }
+
+    p = (*alloc)((long)entries*sizeof(ARP_ENTRY));
+    if (p)
+    {
+        arpEntries = p;
+        arp_num = entries;
+    }
+
+    return arp_init();
+}
+
 int16 arp_init(void)
 {
     ARP_ENTRY *walk;
     int i;
 
     /* clear ARP cache */
-    for (i = 0, walk = arpEntries; i < ARP_NUM; i++, walk++)
+    for (i = 0, walk = arpEntries; i < arp_num; i++, walk++)
     {
         walk->ip_addr = 0;
         memset(walk->ether,0,ETH_ALEN);
         walk->used = 0;
     }
+    last_hit = NULL;
+    sweep = 0;
 
-    return ARP_NUM;
+    return arp_num;
 }
 
-char *arp_cache(uint32 ip_addr)
+/*
+ *  find an entry
+ *
+ *  the instrumentation counters are only updated if 'count' is set, so
+ *  that they describe the lookups done on behalf of outgoing dgrams
+ */
+static ARP_ENTRY *lookup(uint32 ip_addr,int16 count)
 {
     ARP_ENTRY *walk;
-    int16 i, n;
+    int16 i, n, step;
 
-    n = ((uint16)(ip_addr & 0x000000ffL)) % ARP_NUM;    /* starting point */
+    if (count)
+        arp_lookups++;
 
-    for (i = n, walk = arpEntries+n; i < ARP_NUM; i++, walk++)
-        if (walk->used && (walk->ip_addr == ip_addr))
-            return walk->ether;
+    walk = last_hit;
+    if (walk && (walk->ip_addr == ip_addr) && (walk->used & ARP_USED))
+    {
+        if (count)
+            arp_fast_hits++;
+        return walk;
+    }
 
-    for (i = 0, walk = arpEntries; i < n; i++, walk++)
-        if (walk->used && (walk->ip_addr == ip_addr))
-            return walk->ether;
+    n = HASH(ip_addr);
+    step = STEP(ip_addr);
+    for (i = 0; i < ARP_PROBE; i++)
+    {
+        walk = arpEntries + n;
+        if (count)
+            arp_probes++;
+        if (!walk->used)                /* never used: end of probe sequence */
+            break;
+        if ((walk->ip_addr == ip_addr) && (walk->used & ARP_USED))
+            return last_hit = walk;
+        if ((n += step) >= arp_num)
+            n -= arp_num;
+    }
 
     return NULL;
 }
 
-void arp_enter(uint32 ip_addr,char *ether_addr)
+char *arp_cache(uint32 ip_addr)
 {
     ARP_ENTRY *walk;
-    int16 i, n;
 
-    n = ((uint16)(ip_addr & 0x000000ffL)) % ARP_NUM;    /* starting point */
+    if ((walk=lookup(ip_addr,1)) == NULL)
+        return NULL;
+
+    walk->used |= ARP_REFERENCED;
+    walk->last_used = ++use_count;
+
+    return walk->ether;
+}
+
+/*
+ *  update an existing entry with new information
+ *      returns 1 if the entry exists, 0 otherwise
+ */
+int16 arp_update(uint32 ip_addr,char *ether_addr)
+{
+    ARP_ENTRY *walk;
+
+    if ((walk=lookup(ip_addr,0)) == NULL)
+        return 0;
+
+    update(walk,ip_addr,ether_addr);
+
+    return 1;
+}
+
+/*
+ *  add an entry (or update an existing one)
+ *
+ *  the new entry goes in the first free entry of its probe sequence; if
+ *  there is none, the least-recently-used entry in the sequence that is
+ *  not pinned is replaced
+ */
+void arp_enter(uint32 ip_addr,char *ether_addr)
+{
+    ARP_ENTRY *walk, *lru = NULL;
+    int16 i, n, step;
+
+    if (arp_update(ip_addr,ether_addr))
+        return;
 
-    for (i = n, walk = arpEntries+n; i < ARP_NUM; i++, walk++)
-        if (!walk->used)
+    n = HASH(ip_addr);
+    step = STEP(ip_addr);
+    for (i = 0; i < ARP_PROBE; i++)
+    {
+        walk = arpEntries + n;
+        if (!(walk->used & ARP_USED))   /* never used, or tombstone */
         {
             update(walk,ip_addr,ether_addr);
             return;
         }
+        if (!(walk->used & ARP_PINNED))
+            if (!lru || (use_count-walk->last_used > use_count-lru->last_used))
+                lru = walk;
+        if ((n += step) >= arp_num)
+            n -= arp_num;
+    }
+
+    if (lru)                    /* else everything is pinned */
+    {
+        update(lru,ip_addr,ether_addr);
+        arp_evicted++;
+    }
+}
+
+/*
+ *  pin (or unpin) an existing entry, so that it is never evicted or expired
+ *      returns 1 if the entry exists, 0 otherwise
+ */
+int16 arp_pin(uint32 ip_addr,int16 pinned)
+{
+    ARP_ENTRY *walk;
+
+    if ((walk=lookup(ip_addr,0)) == NULL)
+        return 0;
+
+    if (pinned)
+        walk->used |= ARP_PINNED;
+    else walk->used &= ~ARP_PINNED;
 
-    for (i = 0, walk = arpEntries; i < n; i++, walk++)
-        if (!walk->used)
+    return 1;
+}
+
+/*
+ *  age the cache: called periodically, it checks the next ARP_SWEEP
+ *  entries, expiring unpinned entries that are too old, and looking for
+ *  an entry that is in use and will soon expire, so that the caller can
+ *  refresh it before it does
+ *      returns the entry's ether address (and sets *ip_addr) if found,
+ *          otherwise NULL
+ *
+ *  each entry is returned once per lifetime
+ */
+char *arp_refresh(uint32 *ip_addr)
+{
+    ARP_ENTRY *walk;
+    int32 age;
+    int i;
+
+    for (i = 0; i < ARP_SWEEP; i++)
+    {
+        walk = arpEntries + sweep;
+        if (++sweep >= arp_num)
+            sweep = 0;
+
+        if (!(walk->used & ARP_USED))
+            continue;
+
+        age = TIMER_elapsed(walk->confirmed);
+        if (!(walk->used & ARP_PINNED) && (age >= ARP_LIFETIME_MS))
         {
-            update(walk,ip_addr,ether_addr);
-            return;
+            walk->used = ARP_DELETED;
+            arp_expired++;
+            continue;
         }
 
-    /* ARP cache is apparently full, so replace one entry */
-    update(arpEntries+n,ip_addr,ether_addr);
+        if ((walk->used & (ARP_REFERENCED|ARP_REFRESHING)) != ARP_REFERENCED)
+            continue;
+        if (age < ARP_REFRESH_MS)
+            continue;
+        walk->used |= ARP_REFRESHING;
+        *ip_addr = walk->ip_addr;
+        return walk->ether;
+    }
+
+    return NULL;
 }
 
 static void update(ARP_ENTRY *arp,uint32 ip,char *mac)
 {
     arp->ip_addr = ip;
     memcpy(arp->ether,mac,ETH_ALEN);
-    arp->used = 1;
+    arp->used = (arp->used & ARP_PINNED) | ARP_USED;
+    arp->confirmed = TIMER_now();
 }
 
 /*
@@ -125,8 +339,8 @@ int16 arp_count(void)
     int16 count = 0;
 
     /* just look through all entries */
-    for (i = 0, walk = arpEntries; i < ARP_NUM; i++, walk++)
-        if (walk->used)
+    for (i = 0, walk = arpEntries; i < arp_num; i++, walk++)
+        if (walk->used & ARP_USED)
             count++;
 
     return count;
@@ -138,11 +352,28 @@ void arp_table(ARP_INFO *info)
     int i;
 
     /* just look through all entries */
-    for (i = 0, walk = arpEntries; i < ARP_NUM; i++, walk++)
-        if (walk->used)
+    for (i = 0, walk = arpEntries; i < arp_num; i++, walk++)
+        if (walk->used & ARP_USED)
+        {
+            info->ip_addr = walk->ip_addr;      /* copy entry to output */
+            memcpy(info->ether,walk->ether,ETH_ALEN);
+            info++;
+        }
+}
+
+void arp_xtable(ARP_XINFO *info)
+{
+    ARP_ENTRY *walk;
+    int i;
+
+    /* just look through all entries */
+    for (i = 0, walk = arpEntries; i < arp_num; i++, walk++)
+        if (walk->used & ARP_USED)
         {
             info->ip_addr = walk->ip_addr;      /* copy entry to output */
             memcpy(info->ether,walk->ether,ETH_ALEN);
+            info->flags = (walk->used & ARP_PINNED) ? ARP_INFO_PINNED : 0;
+            info->age = TIMER_elapsed(walk->confirmed) / 1000L;
             info++;
         }
 }
@@ -23,10 +23,21 @@
 
 #include "usbsting.h"
 
+int16 arp_setup(int16 entries, void *(*alloc)(long size));  /* returns number of entries */
 int16 arp_init(void);       /* returns number of entries */
 char *arp_cache(uint32 ip_addr);
 void arp_enter(uint32 ip_addr, char ether_addr[ETH_ALEN]);
+int16 arp_update(uint32 ip_addr, char *ether_addr);
+int16 arp_pin(uint32 ip_addr, int16 pinned);
+char *arp_refresh(uint32 *ip_addr);
 int16 arp_count(void);      /* instrumentation */
 void arp_table(ARP_INFO *info);
+void arp_xtable(ARP_XINFO *info);
+
+extern int32 arp_expired;   /* instrumentation */
+extern int32 arp_evicted;
+extern int32 arp_lookups;
+extern int32 arp_fast_hits;
+extern int32 arp_probes;
 
 #endif
@@ -24,14 +24,14 @@
  */
 
 /*
- * IMPORTANT: you must compile with default short ints because the
- * STinG & USB APIs expect this ...
+ * explicit-width types: the USB data structures do not depend on the
+ * size of int, so these sources compile with or without -mshort
  */
-#if __SIZEOF_INT__ != 2
-# error you must compile with short ints!
-#endif
-
+#if defined(__SIZEOF_LONG__) && (__SIZEOF_LONG__ > 4)
+typedef unsigned int   u32;
+#else
 typedef unsigned long  u32;
+#endif
 typedef unsigned short u16;
 typedef unsigned char  u8;
 #define __u32 u32
@@ -57,11 +57,18 @@ static struct usb_module_api *api = NULL;
  * Glue defines
  */
 #define ALLOC_CACHE_ALIGN_BUFFER(x, y, z) x y[z]
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define le2cpu16(x) (x)     // little-endian host build (see host/)
+#define le2cpu32(x) (x)
+#else
 #define le2cpu16(x) ((((x) & 0xFF00) >> 8) | (((x) & 0x00FF) << 8))
 #define le2cpu32(x) ((((x) & 0xFF000000UL) >> 24) | (((x) & 0x00FF0000UL) >> 8) | (((x) & 0x0000FF00UL) << 8) | (((x) & 0x000000FFUL) << 24))
+#endif
 #define cpu2le16(x) le2cpu16((x))
 #define cpu2le32(x) le2cpu32((x))
+#ifndef hz_200             // the host build supplies its own clock
 #define hz_200      *(volatile unsigned long *)0x4ba
+#endif
 #define ETH_ALEN    6       // length of a MAC address
 #define ETH_MAX_LEN 1514    // max size of ethernet packet (see usbsting.h)
 #define FALSE       (0)
@@ -135,6 +142,10 @@ static struct usb_module_api *api = NULL;
      AX_MEDIUM_AC)
 
 /* AX88772 & AX88178 RX_CTL values */
+#define AX_RX_CTL_MFB_2048  0x0000  /* maximum frame burst per bulk-in transfer */
+#define AX_RX_CTL_MFB_4096  0x0100
+#define AX_RX_CTL_MFB_8192  0x0200
+#define AX_RX_CTL_MFB_16384 0x0300
 #define AX_RX_CTL_SO        0x0080
 #define AX_RX_CTL_AB        0x0008
 
@@ -153,9 +164,60 @@ static struct usb_module_api *api = NULL;
 #define USB_BULK_SEND_TIMEOUT 5000
 #define USB_BULK_RECV_TIMEOUT 5000
 
-#define AX_RX_URB_SIZE 2048
+/*
+ * receive buffering: each bulk-in transfer requests AX_RX_URB_SIZE bytes,
+ * and the chip is told to burst that many bytes of frames per transfer.
+ * larger values reduce the number of USB transactions per frame received,
+ * at the cost of memory (AX_RX_BUFFERS * AX_RX_URB_SIZE bytes).  both may
+ * be overridden at build time, e.g. via CPPFLAGS in the Makefile.
+ */
+#ifndef AX_RX_URB_SIZE
+#define AX_RX_URB_SIZE 2048     /* 2048, 4096, 8192 or 16384 */
+#endif
+#ifndef AX_RX_BUFFERS
+#define AX_RX_BUFFERS 2         /* 2 or more */
+#endif
+
+#if AX_RX_URB_SIZE == 2048
+# define AX_RX_CTL_MFB  AX_RX_CTL_MFB_2048
+#elif AX_RX_URB_SIZE == 4096
+# define AX_RX_CTL_MFB  AX_RX_CTL_MFB_4096
+#elif AX_RX_URB_SIZE == 8192
+# define AX_RX_CTL_MFB  AX_RX_CTL_MFB_8192
+#elif AX_RX_URB_SIZE == 16384
+# define AX_RX_CTL_MFB  AX_RX_CTL_MFB_16384
+#else
+# error AX_RX_URB_SIZE must be 2048, 4096, 8192 or 16384
+#endif
+#if AX_RX_BUFFERS < 2
+# error AX_RX_BUFFERS must be at least 2
+#endif
+
+/*
+ * transmit batching: frames are collected in a buffer of AX_TX_BUFSIZE
+ * bytes (each preceded by its 4-byte header) & sent in a single bulk-out
+ * transfer.  dev->tx_batch further limits the size of each transfer at
+ * run time.
+ */
+#ifndef AX_TX_BUFSIZE
+#define AX_TX_BUFSIZE 8192
+#endif
+#if AX_TX_BUFSIZE < 2048
+# error AX_TX_BUFSIZE must be at least 2048
+#endif
+#define AX_TX_FRAMELEN  (sizeof(u32)+ETH_MAX_LEN)   /* largest header + frame */
+#define AX_TX_PAD       0xffff0000UL    /* header of zero-length frame */
+
 #define PHY_CONNECT_TIMEOUT 5000
 
+/*
+ * status reports from the interrupt endpoint: these contain the link
+ * state (they say nothing about whether received data is waiting)
+ */
+#define AX_STATUS_LEN       8
+#define AX_STATUS_LINK      0x01        /* in byte 2 of report */
+#define AX_STATUS_TICKS     20          /* 200Hz ticks between polls (100ms) */
+
 /* asix_flags defines */
 #define FLAG_NONE           0
 #define FLAG_TYPE_AX88172   (1U << 0)
@@ -524,13 +586,19 @@ static int asix_basic_reset_772(struct ueth_data *dev)
  */
 static long asix_init(struct ueth_data  *dev)
 {
+    struct asix_private *priv = (struct asix_private *)dev->dev_priv;
     int timeout = 0;
 #define TIMEOUT_RESOLUTION 50   /* ms */
     int link_detected;
+    u16 rx_ctl = AX_DEFAULT_RX_CTL;
 
     DEBUG(("** %s()\n", __func__));
 
-    if (asix_write_rx_ctl(dev, AX_DEFAULT_RX_CTL) < 0)
+    /* match the chip's burst size to our bulk-in transfer size */
+    if (!(priv->flags & FLAG_TYPE_AX88172))
+        rx_ctl |= AX_RX_CTL_MFB;
+
+    if (asix_write_rx_ctl(dev, rx_ctl) < 0)
         goto out_err;
 
     do {
@@ -558,42 +626,181 @@ out_err:
     return -1;
 }
 
-static struct {
-    u32 packet_len;
-    char ipdata[ETH_MAX_LEN];
-} msg;
+/*
+ * the transmit buffer holds a sequence of frames, each preceded by its
+ * 4-byte header & padded to an even length, so that the next header is
+ * aligned; there is room at the end for a padding header
+ */
+static unsigned char tx_buf[AX_TX_BUFSIZE+sizeof(u32)] __attribute__ ((aligned(4)));
+static long tx_len = 0L;        /* bytes in tx_buf */
+
+/*
+ * asix_send_buffer(): return the address at which to assemble the next frame
+ *
+ * A caller may assemble a frame here and pass it to asix_send(), which
+ * then does not need to copy it.  NULL is returned if the current batch
+ * has no room for a further frame of maximum size: asix_send_flush()
+ * must be called first.
+ */
+void *asix_send_buffer(struct ueth_data *dev)
+{
+    struct asix_private *priv = (struct asix_private *)dev->dev_priv;
+    long limit;
+
+    limit = dev->tx_batch;
+    if (limit > AX_TX_BUFSIZE)
+        limit = AX_TX_BUFSIZE;
+    if (priv && (priv->flags & FLAG_TYPE_AX88172))
+        limit = 0L;                 /* one frame per transfer */
+
+    if (tx_len && (tx_len + AX_TX_FRAMELEN > limit))
+        return NULL;
+
+    return tx_buf + tx_len + sizeof(u32);
+}
+
+/*
+ * asix_send(): add a frame to the current batch
+ *
+ * The frame is not sent until asix_send_flush() is called; the caller
+ * must check that there is room via asix_send_buffer() first.
+ */
 long asix_send(struct ueth_data *dev, void *packet, long length)
 {
-    long err = 0;
     u32 packet_len;
-    long actual_len = 0;
-    long size;
+    unsigned char *p;
 
     DEBUG(("** %s(), len %ld\n", __func__, length));
     if (dev->pusb_dev == 0) {
         return 0;
     }
 
+    /* the frame must fit in the buffer & the 11-bit length field */
+    if ((length <= 0) || (length > ETH_MAX_LEN)) {
+        DEBUG(("Tx: invalid frame length %ld\n", length));
+        return -1;
+    }
+    if (tx_len + AX_TX_FRAMELEN > AX_TX_BUFSIZE) {
+        DEBUG(("Tx: no room in batch\n"));
+        return -1;
+    }
+
+    p = tx_buf + tx_len;
     packet_len = ((length ^ 0x0000ffff) << 16) + length;
-    msg.packet_len = cpu2le32(packet_len);
-    memcpy(msg.ipdata, (void *)packet, length);
+    *(u32 *)p = cpu2le32(packet_len);
+    p += sizeof(u32);
+    if (packet != p)
+        memcpy(p, (void *)packet, length);
     if (length & 1)
         length++;
 
-    size = length + sizeof(packet_len);
+    tx_len += length + sizeof(packet_len);
+
+    return 0;
+}
+
+/*
+ * asix_send_flush(): send the current batch of frames (if any)
+ *
+ * The batch is emptied even if the transfer fails.
+ */
+long asix_send_flush(struct ueth_data *dev)
+{
+    struct asix_private *priv = (struct asix_private *)dev->dev_priv;
+    long err = 0;
+    long actual_len = 0;
+    long maxpacket;
+
+    if (tx_len == 0L)
+        return 0;
+
+    if (dev->pusb_dev == 0) {
+        tx_len = 0L;
+        return 0;
+    }
+
+    /*
+     * a transfer that is an exact multiple of the endpoint's packet size
+     * would need a zero-length packet to terminate it: instead, we append
+     * a header for a zero-length frame, which the chip ignores
+     */
+    maxpacket = dev->pusb_dev->epmaxpacketout[dev->ep_out];
+    if (priv && !(priv->flags & FLAG_TYPE_AX88172)
+     && (maxpacket > 0) && ((tx_len % maxpacket) == 0)) {
+        *(u32 *)(tx_buf + tx_len) = cpu2le32(AX_TX_PAD);
+        tx_len += sizeof(u32);
+    }
 
     err = usb_bulk_msg(dev->pusb_dev,
                 usb_sndbulkpipe(dev->pusb_dev, (long)dev->ep_out),
-                (void *)&msg,
-                size,
+                (void *)tx_buf,
+                tx_len,
                 &actual_len,
                 USB_BULK_SEND_TIMEOUT, 0);
 
+    tx_len = 0L;
+
     return err ? -1 : 0;
 }
 
 /*
- * asix_recv(): receive one ethernet packet into the destination buffer
+ * link status handling
+ *
+ * The status endpoint is polled at most every AX_STATUS_TICKS, and the
+ * USB stack calls asix_status_irq() with each report received.  A new
+ * transfer is only submitted once the previous one has completed.  While the
+ * link is down, no packets can arrive, so asix_recv_ptr() skips the bulk-in
+ * transfer.  The link is assumed to be up until a report says otherwise, so
+ * that nothing changes if the USB stack never delivers reports.
+ */
+static u8 status_buf[AX_STATUS_LEN] __attribute__ ((aligned(4)));
+static int link_up = TRUE;
+static int status_pending = FALSE;     /* TRUE => transfer submitted, not completed */
+static unsigned long last_status = 0UL;
+
+static long asix_status_irq(struct usb_device *udev)
+{
+    struct ueth_data *dev = (struct ueth_data *)udev->privptr;
+    int link;
+
+    status_pending = FALSE;
+
+    if (udev->irq_status || (udev->irq_act_len < AX_STATUS_LEN))
+        return 1;
+
+    link = (status_buf[2] & AX_STATUS_LINK) ? TRUE : FALSE;
+    if (link != link_up) {
+        DEBUG(("link %s\n", link ? "up" : "down"));
+        link_up = link;
+        dev->link_changes++;
+    }
+
+    return 1;
+}
+
+static void asix_poll_status(struct ueth_data *dev)
+{
+    if (status_pending || (hz_200 - last_status < AX_STATUS_TICKS))
+        return;
+    last_status = hz_200;
+
+    status_pending = TRUE;      /* first, in case the stack completes it at once */
+    if (usb_submit_int_msg(dev->pusb_dev,
+                usb_rcvintpipe(dev->pusb_dev, (long)dev->ep_int),
+                (void *)status_buf,
+                AX_STATUS_LEN,
+                (long)dev->irqinterval) != 0)
+        status_pending = FALSE; /* not submitted: no completion will come */
+}
+
+/*
+ * asix_recv_ptr(): receive one ethernet packet, without copying it
+ *
+ * On return, *packet points to the packet within our receive buffer; it
+ * remains valid until the next call.  Packets that wrap at the end of the
+ * receive buffer cannot be returned in place, so they are copied into
+ * wrap_buf (which must be at least 16-bit aligned) and *packet points
+ * there instead.
  *
  * Background info for understanding the code:
  * . The Asix chip collects ethernet packets into a stream of bytes, each
@@ -603,6 +810,10 @@ long asix_send(struct ueth_data *dev, void *packet, long length)
  *   the stream, up to a max of AX_RX_URB_SIZE bytes.  The actual number
  *   of bytes received is returned.  If this number is zero, then the chip
  *   has no more data in its buffers at the moment.
+ * . The receive buffer is a ring of AX_RX_BUFFERS buffers, each of
+ *   AX_RX_URB_SIZE bytes.  We only request more data when at least one
+ *   whole buffer is free, and a short transfer ends the stream, so the
+ *   data in the ring is always contiguous (apart from wrapping).
  *
  * The code implicitly assumes that the maximum size of an Ethernet packet
  * is less than or equal to AX_RX_URB_SIZE.
@@ -613,10 +824,11 @@ long asix_send(struct ueth_data *dev, void *packet, long length)
  * . A negative return code indicates an error (see the code for the
  *   meaning of specific negative values)
  */
-#define RECV_BUFSIZE    (2*AX_RX_URB_SIZE)      /* code only handles 2 buffers */
-static unsigned char recv_buf[RECV_BUFSIZE];
+#define RECV_BUFSIZE    ((long)AX_RX_BUFFERS*AX_RX_URB_SIZE)
+static unsigned char recv_buf[RECV_BUFSIZE] __attribute__ ((aligned(4)));  /* packets are parsed in place */
 
-long asix_recv(struct ueth_data *dev, unsigned char *dest_buf, unsigned long dest_len)
+long asix_recv_ptr(struct ueth_data *dev, unsigned char **packet,
+                   unsigned char *wrap_buf, unsigned long wrap_len)
 {
     static unsigned char *fill_ptr = recv_buf;
     static unsigned char *empty_ptr = recv_buf;
@@ -627,13 +839,19 @@ long asix_recv(struct ueth_data *dev, unsigned char *dest_buf, unsigned long des
     long actual_len;
     u32 packet_len;
     long err = 0L;
-    int i, do_copy, wrap;
+    long wrap;              /* the ring may exceed 32K, so not int (-mshort) */
+    int i, do_copy;
 
     if (dev->pusb_dev == 0) {
         return -1L;
     }
 
-    if (!end_of_stream && (bytes_remaining <= AX_RX_URB_SIZE)) {
+    asix_poll_status(dev);
+
+    if (!end_of_stream && (bytes_remaining <= RECV_BUFSIZE-AX_RX_URB_SIZE) && !link_up) {
+        /* no packets can arrive while the link is down */
+        dev->rx_skipped++;
+    } else if (!end_of_stream && (bytes_remaining <= RECV_BUFSIZE-AX_RX_URB_SIZE)) {
         /* more bytes available, and room for more bytes in our buffer */
         err = usb_bulk_msg(dev->pusb_dev,
                     usb_rcvbulkpipe(dev->pusb_dev, (long)dev->ep_in),
@@ -643,10 +861,9 @@ long asix_recv(struct ueth_data *dev, unsigned char *dest_buf, unsigned long des
                     USB_BULK_RECV_TIMEOUT,
                     USB_BULK_FLAG_EARLY_TIMEOUT);
 
-        /* switch to other buffer for next receive */
-        if (fill_ptr == recv_buf)
-            fill_ptr = recv_buf + AX_RX_URB_SIZE;
-        else
+        /* switch to next buffer for next receive */
+        fill_ptr += AX_RX_URB_SIZE;
+        if (fill_ptr >= end_buf)
             fill_ptr = recv_buf;
 
         /*
@@ -724,24 +941,25 @@ long asix_recv(struct ueth_data *dev, unsigned char *dest_buf, unsigned long des
 
     /*
      * at last, the normal case, but we still need to check if the
-     * destination buffer is large enough
+     * packet would fit in the caller's buffer
      */
     do_copy = TRUE;
-    if (packet_len > dest_len) {
-        DEBUG(("Rx: packet_len=%ld > dest_len=%ld\n", packet_len, dest_len));
+    if (packet_len > wrap_len) {
+        DEBUG(("Rx: packet_len=%ld > wrap_len=%ld\n", packet_len, wrap_len));
         do_copy = FALSE;
     }
 
     wrap = empty_ptr + packet_len - end_buf;
-    if (wrap > 0) {         /* packet wraps */
+    if (wrap > 0) {         /* packet wraps: we must copy it */
+        dev->rx_wrapped++;
         if (do_copy) {
-            memcpy(dest_buf, empty_ptr, packet_len-wrap);
-            memcpy(dest_buf+packet_len-wrap, recv_buf, wrap);
+            memcpy(wrap_buf, empty_ptr, packet_len-wrap);
+            memcpy(wrap_buf+packet_len-wrap, recv_buf, wrap);
         }
+        *packet = wrap_buf;
         empty_ptr = recv_buf + wrap;
-    } else {
-        if (do_copy)
-            memcpy(dest_buf, empty_ptr, packet_len);
+    } else {                /* normal case: return packet in place */
+        *packet = empty_ptr;
         empty_ptr += packet_len;
     }
     err = packet_len;       /* value to return */
@@ -751,10 +969,12 @@ long asix_recv(struct ueth_data *dev, unsigned char *dest_buf, unsigned long des
         packet_len++;
         empty_ptr++;
     }
+    if (empty_ptr >= end_buf)   /* packet ended exactly at end of buffer */
+        empty_ptr = recv_buf;
     bytes_remaining -= sizeof(packet_len) + packet_len;
 
     /*
-     * if dest_len was too short, we return an error, dropping the packet
+     * if wrap_len was too short, we return an error, dropping the packet
      * but continuing with the remaining data
      */
     if (!do_copy)
@@ -766,6 +986,8 @@ long asix_recv(struct ueth_data *dev, unsigned char *dest_buf, unsigned long des
      * error exit
      */
 out:
+    if (err < 0L)
+        dev->rx_resets++;
     end_of_stream = FALSE;
     bytes_remaining = 0L;
     fill_ptr = empty_ptr = recv_buf;
@@ -915,6 +1137,10 @@ asix_eth_get_info(struct usb_device *dev, struct ueth_data *ss, unsigned char* m
     DEBUG(("asix_get_info: before asix_init\n"));
     asix_init(ss);
 
+    link_up = TRUE;                     /* forget any state from a previous device */
+    status_pending = FALSE;
+    dev->irq_handle = asix_status_irq;  /* for link status reports */
+
     DEBUG(("asix_get_info: done\n"));
 
     return 1;
@@ -27,7 +27,9 @@ void asix_eth_before_probe(void *a);
 long asix_eth_probe(struct usb_device *dev, unsigned int ifnum, struct ueth_data *ss);
 long asix_eth_get_info(struct usb_device *dev, struct ueth_data *ss, unsigned char* mac);
 int asix_read_mac(struct ueth_data *dev, unsigned char *mac_address);
+void *asix_send_buffer(struct ueth_data *dev);
 long asix_send(struct ueth_data *dev, void *packet, long length);
-long asix_recv(struct ueth_data *dev, unsigned char *dest_buf, unsigned long dest_len);
+long asix_send_flush(struct ueth_data *dev);
+long asix_recv_ptr(struct ueth_data *dev, unsigned char **packet, unsigned char *wrap_buf, unsigned long wrap_len);
 
 #endif
@@ -26,14 +26,14 @@
  */
 
 /*
- * IMPORTANT: you must compile with default short ints because the
- * STinG & USB APIs expect this ...
+ * explicit-width types: the USB data structures do not depend on the
+ * size of int, so these sources compile with or without -mshort
  */
-#if __SIZEOF_INT__ != 2
-# error you must compile with short ints!
-#endif
-
+#if defined(__SIZEOF_LONG__) && (__SIZEOF_LONG__ > 4)
+typedef unsigned int   u32;
+#else
 typedef unsigned long  u32;
+#endif
 typedef unsigned short u16;
 typedef unsigned char  u8;
 #define __u32 u32
@@ -59,11 +59,18 @@ static struct usb_module_api   *api = NULL;
  * Glue defines
  */
 #define ALLOC_CACHE_ALIGN_BUFFER(x, y, z) x y[z]
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define le2cpu16(x) (x)     // little-endian host build (see host/)
+#define le2cpu32(x) (x)
+#else
 #define le2cpu16(x) ((((x) & 0xFF00) >> 8) | (((x) & 0x00FF) << 8))
 #define le2cpu32(x) ((((x) & 0xFF000000UL) >> 24) | (((x) & 0x00FF0000UL) >> 8) | (((x) & 0x0000FF00UL) << 8) | (((x) & 0x000000FFUL) << 24))
+#endif
 #define cpu2le16(x) le2cpu16((x))
 #define cpu2le32(x) le2cpu32((x))
+#ifndef hz_200             // the host build supplies its own clock
 #define hz_200      *(volatile unsigned long *)0x4ba
+#endif
 #define ETH_ALEN    6       // length of a MAC address
 #define ETH_MAX_LEN 1514    // max size of ethernet packet (see usbsting.h)
 #define FALSE       (0)
@@ -287,141 +294,289 @@ static long picowifi_init(struct ueth_data	*dev)
 	return 0;
 }
 
+/*
+ * transmit batching: since each record is self-delimiting, several
+ * records can be sent in one bulk-out transfer, up to the size of the
+ * device FIFO.  records are not padded, so a frame of odd length ends
+ * the batch: the following header would be misaligned.
+ */
+#define TX_BUFSIZE 4096		/* the device FIFO */
+#define TX_RECLEN (offsetof(pkt_s, payload)+ETH_MAX_LEN)	/* largest record */
+
+static u8 outbuf[TX_BUFSIZE] __attribute__ ((aligned(4)));
+static long out_len = 0;	/* bytes in outbuf */
+static int out_closed = FALSE;	/* TRUE => no more records may be added */
+
+/*
+ * picowifi_send_buffer(): return the address at which to assemble the
+ * next frame
+ *
+ * A caller may assemble a frame here and pass it to picowifi_send(),
+ * which then does not need to copy it.  NULL is returned if the current
+ * batch cannot take a further frame of maximum size: picowifi_send_flush()
+ * must be called first.
+ */
+void *picowifi_send_buffer(struct ueth_data *dev)
+{
+	long limit;
+
+	limit = (dev->tx_batch < TX_BUFSIZE) ? dev->tx_batch : TX_BUFSIZE;
+
+	if (out_len && (out_closed || (out_len + TX_RECLEN > limit)))
+		return NULL;
+
+	return outbuf + out_len + offsetof(pkt_s, payload);
+}
+
+/*
+ * picowifi_send(): add a frame to the current batch
+ *
+ * The frame is not sent until picowifi_send_flush() is called; the
+ * caller must check that there is room via picowifi_send_buffer() first.
+ */
 long picowifi_send(struct ueth_data *dev, void *packet, long length)
 {
-	static pkt_s outpkt;
-	long size;
-	long actual_len;
-	long err;
+	pkt_hdr_s *hdr;
 
 	DEBUGOUT(("** %s(), len %ld\r\n", __func__, length));
 	if (dev->pusb_dev == 0) {
 		return 0;
 	}
 
-	outpkt.magic = cpu2le32(MAGIC);
-	outpkt.len   = cpu2le32(length);
+	if ((length <= 0) || (length > ETH_MAX_LEN)) {
+		DEBUGOUT(("Tx: invalid frame length %ld\r\n", length));
+		return -1;
+	}
+	if (out_closed || (out_len + TX_RECLEN > TX_BUFSIZE)) {
+		DEBUGOUT(("Tx: no room in batch\r\n"));
+		return -1;
+	}
+
+	hdr = (pkt_hdr_s *)(outbuf + out_len);
+	hdr->magic = cpu2le32(MAGIC);
+	hdr->len   = cpu2le32(length);
+
+	if (packet != (void *)(hdr + 1))
+		memcpy(hdr + 1, packet, length);
+
+	out_len += offsetof(pkt_s, payload) + length;
+	if (length & 1)
+		out_closed = TRUE;
+
+	return 0;
+}
+
+/*
+ * picowifi_send_flush(): send the current batch of records (if any)
+ *
+ * The batch is emptied even if the transfer fails.
+ */
+long picowifi_send_flush(struct ueth_data *dev)
+{
+	long actual_len;
+	long err;
 
-	memcpy(outpkt.payload, packet, length);
+	if (out_len == 0) {
+		return 0;
+	}
 
-	size = length + offsetof(pkt_s, payload);
+	if (dev->pusb_dev == 0) {
+		out_len = 0;
+		out_closed = FALSE;
+		return 0;
+	}
 
 	err = usb_bulk_msg(dev->pusb_dev,
 				usb_sndbulkpipe(dev->pusb_dev, (long)dev->ep_out),
-				(void *)&outpkt,
-				size,
+				(void *)outbuf,
+				out_len,
 				&actual_len,
 				USB_BULK_SEND_TIMEOUT, 0);
 
+	out_len = 0;
+	out_closed = FALSE;
+
 	if (err != 0)
 		return -1;
 	else
 		return 0;
 }
 
-#define FIFO_SIZE (2*4096) // twice the device FIFO
+/*
+ * receive ring: USB transfers are received directly into the ring, and
+ * records are parsed in place.  each transfer must be contiguous, so if
+ * there is more free space at the start of the ring than at the end, the
+ * next transfer goes to the start, and the data at the end stops at
+ * 'limit' (i.e. a bip buffer).  records are not aligned to transfers, so
+ * a record may wrap: its header is then extracted piecewise, and its
+ * payload copied to the caller's buffer.
+ */
+#define RX_XFERSIZE 4096	/* should match the *device* fifo */
+#define RX_RINGSIZE (2*RX_XFERSIZE)
 static struct {
-	u8  buffer[FIFO_SIZE];
-	int level;
-	int readidx;
-	int writeidx;
-} recv_fifo;
-
-static void fifo_reset(void)
+	u8   buffer[RX_RINGSIZE];
+	long level;		/* unread bytes */
+	long readidx;		/* next unread byte */
+	long writeidx;		/* where the next transfer is received */
+	long limit;		/* end of data at the end of the ring, if wrapped */
+	int  wrapped;		/* TRUE => data continues at the start of the ring */
+} recv_ring __attribute__ ((aligned(4)));
+
+static void ring_reset(void)
 {
-	recv_fifo.readidx = recv_fifo.writeidx = recv_fifo.level = 0;
+	recv_ring.level = recv_ring.readidx = recv_ring.writeidx = 0;
+	recv_ring.wrapped = FALSE;
 }
 
-static void fifo_enqueue(u8* data, int len)
-{
-
-	if (recv_fifo.writeidx + len <= FIFO_SIZE) {
-		memcpy(&recv_fifo.buffer[recv_fifo.writeidx], data, len);
-		recv_fifo.level += len;
-		recv_fifo.writeidx += len;
-	} else { // data goes past the break
-		int part1 = FIFO_SIZE - recv_fifo.writeidx;
-		int part2 = len - part1;
-		memcpy(&recv_fifo.buffer[recv_fifo.writeidx], data, part1);
-		memcpy(&recv_fifo.buffer[0], &data[part1], part2);
-		recv_fifo.level += len;
-		recv_fifo.writeidx += len - FIFO_SIZE;
-	}
-
-}
-
-static void fifo_dequeue(u8* data, int len, int peek)
+/*
+ * copy (if data is not NULL) & optionally remove the next len bytes,
+ * allowing for the data to wrap
+ */
+static void ring_dequeue(u8* data, long len, int peek)
 {
-	if (recv_fifo.readidx + len <= FIFO_SIZE) {
-		memcpy(data, &recv_fifo.buffer[recv_fifo.readidx], len);
-		if (!peek) {
-			recv_fifo.level -= len;
-			recv_fifo.readidx += len;
+	long idx = recv_ring.readidx;
+	int wrapped = recv_ring.wrapped;
+	long n;
+
+	if (!peek)
+		recv_ring.level -= len;
+
+	while (len > 0) {
+		n = (wrapped ? recv_ring.limit : recv_ring.writeidx) - idx;
+		if (n > len)
+			n = len;
+		if (data) {
+			memcpy(data, &recv_ring.buffer[idx], n);
+			data += n;
 		}
-	} else { // data goes past the break
-		int part1 = FIFO_SIZE - recv_fifo.readidx;
-		int part2 = len - part1;
-		memcpy(data, &recv_fifo.buffer[recv_fifo.readidx], part1);
-		memcpy(&data[part1], &recv_fifo.buffer[0], part2);
-		if (!peek) {
-			recv_fifo.level -= len;
-			recv_fifo.readidx += len - FIFO_SIZE;
+		len -= n;
+		idx += n;
+		if (wrapped && (idx >= recv_ring.limit)) {
+			idx = 0;
+			wrapped = FALSE;
 		}
 	}
+
+	if (!peek) {
+		recv_ring.readidx = idx;
+		recv_ring.wrapped = wrapped;
+	}
 }
 
-long picowifi_recv(struct ueth_data *dev, unsigned char *dest_buf, unsigned long dest_len)
+/*
+ * picowifi_recv_ptr(): receive one ethernet packet, without copying it
+ *
+ * On return, *packet points to the packet within the receive ring; it
+ * remains valid until the next call.  Packets that wrap, or that start
+ * at an odd address, cannot be returned in place, so they are copied
+ * into wrap_buf (which must be at least 16-bit aligned) and *packet
+ * points there instead.
+ *
+ * Returns the length of the packet, 0 if none is available, or -1 if a
+ * packet was dropped because it is longer than wrap_len.
+ */
+long picowifi_recv_ptr(struct ueth_data *dev, unsigned char **packet,
+			unsigned char *wrap_buf, unsigned long wrap_len)
 {
-	static u8 recv_buffer[FIFO_SIZE/2]; // should match the *device* fifo
 	static int resync_count = 0;
 	pkt_hdr_s next_hdr;
+	u8 *p;
 	long actual_len = 0;
 	long size = 0;
+	long space, maxpacket;
 	long err;
 
 	if (dev->pusb_dev == 0) {
 		return -1L;
 	}
 
-	if (FIFO_SIZE - recv_fifo.level >= sizeof(recv_buffer)) { // try to get a new packet from USB
+	if (recv_ring.level == 0) {	/* all consumed: start again */
+		ring_reset();
+	}
+
+	/*
+	 * find the largest contiguous free space, & receive into it if it
+	 * can take at least one USB packet.  we request whole packets only,
+	 * so that the device keeps any data that does not fit.
+	 */
+	if (recv_ring.wrapped) {
+		space = recv_ring.readidx - recv_ring.writeidx;
+	} else {
+		space = RX_RINGSIZE - recv_ring.writeidx;
+		if ((space < RX_XFERSIZE) && (recv_ring.readidx > space)) {
+			recv_ring.limit = recv_ring.writeidx;
+			recv_ring.writeidx = 0;
+			recv_ring.wrapped = TRUE;
+			space = recv_ring.readidx;
+		}
+	}
+	if (space > RX_XFERSIZE)
+		space = RX_XFERSIZE;
+	maxpacket = dev->pusb_dev->epmaxpacketin[dev->ep_in];
+	if (maxpacket <= 0)
+		maxpacket = 64;
+	space -= space % maxpacket;
+
+	if (space > 0) { // try to get more data from USB
 		err = usb_bulk_msg(dev->pusb_dev,
 					usb_rcvbulkpipe(dev->pusb_dev, (long)dev->ep_in),
-					(void *)recv_buffer,
-					sizeof(recv_buffer),
+					(void *)&recv_ring.buffer[recv_ring.writeidx],
+					space,
 					&actual_len,
 					USB_BULK_RECV_TIMEOUT,
 					USB_BULK_FLAG_EARLY_TIMEOUT);
 		if ((err == 0) && (actual_len > 0)) { // got new data
 			DEBUGOUT(("actual_len = %ld\n", actual_len));
-			fifo_enqueue(recv_buffer, actual_len);
+			recv_ring.writeidx += actual_len;
+			recv_ring.level += actual_len;
 		}
 	}
 
-	if (recv_fifo.level > offsetof(pkt_s, payload)) {
-		// check if we have a full packet in the FIFO
+	if (recv_ring.level >= sizeof(next_hdr)) {
+		// check if we have a full packet in the ring
 
-		fifo_dequeue((u8*)&next_hdr, sizeof(next_hdr), 1);
+		ring_dequeue((u8*)&next_hdr, sizeof(next_hdr), 1);
+		next_hdr.len = le2cpu32(next_hdr.len);
 
-		if (next_hdr.magic != le2cpu32(MAGIC)) {
-			DEBUGOUT(("invalid magic(%d) = %lx\n", resync_count, next_hdr.magic));
+		if ((next_hdr.magic != le2cpu32(MAGIC)) || (next_hdr.len > MTU)) {
+			DEBUGOUT(("invalid header(%d) = %lx %lx\n", resync_count, next_hdr.magic, next_hdr.len));
 			if (resync_count == 3) {
-				fifo_reset();
+				ring_reset();
 				resync_count = 0;
+				dev->rx_resets++;
 			} else {
-				fifo_dequeue((u8*)&next_hdr, 4, 0); // pop 4 bytes and try to resync
+				ring_dequeue(NULL, 4, 0); // pop 4 bytes and try to resync
 				resync_count++;
+				dev->rx_resyncs++;
 			}
 			return 0;
 		}
 		resync_count = 0;
-		next_hdr.len = le2cpu32(next_hdr.len);
 
-		if (recv_fifo.level >= offsetof(pkt_s, payload) + next_hdr.len) {
+		if (recv_ring.level >= sizeof(next_hdr) + next_hdr.len) {
 			DEBUGOUT(("pkt_recv: len = %ld\n", next_hdr.len));
 
-			size = (dest_len < next_hdr.len) ? dest_len : next_hdr.len; // TODO correctly dequeue packets larger than dst buffer
-			fifo_dequeue((u8*)&next_hdr, sizeof(next_hdr), 0);
-			fifo_dequeue(dest_buf, size, 0);
+			ring_dequeue(NULL, sizeof(next_hdr), 0);
+			size = next_hdr.len;
+
+			if (size > wrap_len) {	/* drop it, but keep in step */
+				DEBUGOUT(("pkt_recv: len = %ld > wrap_len = %ld\n", size, wrap_len));
+				ring_dequeue(NULL, size, 0);
+				return -1L;
+			}
+
+			p = &recv_ring.buffer[recv_ring.readidx];
+			if (recv_ring.wrapped && (recv_ring.readidx + size > recv_ring.limit)) {
+				dev->rx_wrapped++;	/* packet wraps: we must copy it */
+				*packet = wrap_buf;
+				ring_dequeue(wrap_buf, size, 0);
+			} else if ((long)p & 1) {	/* misaligned: we must copy it */
+				*packet = wrap_buf;
+				ring_dequeue(wrap_buf, size, 0);
+			} else {		/* normal case: return packet in place */
+				*packet = p;
+				ring_dequeue(NULL, size, 0);
+			}
 		}
 
 	}
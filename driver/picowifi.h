@@ -28,7 +28,9 @@ void picowifi_eth_before_probe(void *a);
 long picowifi_eth_probe(struct usb_device *dev, unsigned int ifnum, struct ueth_data *ss);
 long picowifi_eth_get_info(struct usb_device *dev, struct ueth_data *ss, unsigned char* mac);
 int picowifi_read_mac(struct ueth_data *dev, unsigned char *mac_address);
+void *picowifi_send_buffer(struct ueth_data *dev);
 long picowifi_send(struct ueth_data *dev, void *packet, long length);
-long picowifi_recv(struct ueth_data *dev, unsigned char *dest_buf, unsigned long dest_len);
+long picowifi_send_flush(struct ueth_data *dev);
+long picowifi_recv_ptr(struct ueth_data *dev, unsigned char **packet, unsigned char *wrap_buf, unsigned long wrap_len);
 
 #endif
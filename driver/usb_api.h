@@ -233,6 +233,12 @@ struct usb_module_api
 //#define	usb_hub_port_connect_change 	(*api->usb_hub_port_connect_change)
 //#define	usb_hub_configure 	(*api->usb_hub_configure)	
 
+#ifndef __mc68000__
+/* not compiling for the Atari (e.g. a native host build): there is no
+ * -mshort ABI to match, so the API can be called directly.
+ */
+#define	usb_control_msg 	(*api->usb_control_msg)
+#else
 /* We have to do usb_control_msg the hard way because we're passing chars and shorts
  * to an API that uses -mshort (and thus 16 bit alignment) while we don't use -mshort.
  */
@@ -277,6 +283,7 @@ __extension__								\
 	);								\
 	retvalue;							\
 })
+#endif /* __mc68000__ */
 
 #endif
 
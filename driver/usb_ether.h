@@ -40,6 +40,18 @@ struct ueth_data {
 
 	/* driver private */
 	void *dev_priv;
+
+	/* receive framing counts, reported via USBNET_STATS */
+	long rx_wrapped;				/* packets wrapped at end of buffer */
+	long rx_resets;					/* buffer discarded after framing error */
+	long rx_resyncs;				/* header resynchronisation attempts */
+
+	/* link status, reported via USBNET_STATS */
+	long link_changes;				/* link state changes reported by device */
+	long rx_skipped;				/* bulk-in reads skipped, link down */
+
+	/* transmit batching, set by the caller */
+	long tx_batch;					/* max bytes per bulk-out transfer */
 };
 
 #endif /* __USB_ETHER_H__ */
@@ -26,13 +26,13 @@
  */
 
 /*
- * IMPORTANT: you must compile with default short ints because the
- * STinG & USB APIs expect this ...
+ * NOTE: the STinG & USB APIs expect 16-bit ints, but all structures and
+ * prototypes shared with them use the explicit-width types from transprt.h,
+ * so this compiles with -mshort (as required for the Atari build) and also
+ * natively on 32/64-bit hosts.
  */
-#if __SIZEOF_INT__ != 2
-# error you must compile with short ints!
-#endif
 
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <osbind.h>
@@ -51,13 +51,34 @@
 #define DRIVER_NAME     "USB_NET.STX"
                                 /* the following values are returned to STinG */
 #define MODULE_NAME     "USB Network"
-#define MODULE_VERSION  "00.50"
-#define MODULE_DAY      31
-#define MODULE_MONTH    07
-#define MODULE_YEAR     2022
+#define MODULE_VERSION  "00.60"
+#define MODULE_DAY      16
+#define MODULE_MONTH    10
+#define MODULE_YEAR     2026
 #define MODULE_DATE     (((MODULE_YEAR-1980)<<9)|(MODULE_MONTH<<5)|(MODULE_DAY))    /* GEMDOS internal format */
 #define MODULE_AUTHOR   "Roger Burrows & Christian Zietz"
 
+/*
+ *  STinG configuration variables (see get_config())
+ */
+#define ARP_ENTRIES_VAR "USBNET_ARP_ENTRIES"    /* ARP cache size */
+#define ARP_ENTRIES     61                      /*  default */
+#define TX_BATCH_VAR    "USBNET_TX_BATCH"       /* max bytes sent per USB transfer */
+#define TX_BATCH        8192L                   /*  default */
+#define POLL_MAX_VAR    "USBNET_POLL_MAX"       /* max ms between reads when idle */
+#define POLL_MAX        20L                     /*  default */
+#define RX_PACKETS_VAR  "USBNET_RX_PACKETS"     /* max packets received per call */
+#define RX_PACKETS      32L                     /*  default */
+#define RX_BYTES_VAR    "USBNET_RX_BYTES"       /* max bytes received per call */
+#define RX_BYTES        16384L                  /*  default */
+
+#define ARP_PENDING     8           /* max destinations awaiting address resolution */
+#define MAX_ROUTES      64          /* max routing table entries examined by arp_announce() */
+#define ARP_TIMEOUT_MS  500L        /* initial ARP retransmission timeout, doubled for each retry */
+#define ARP_RETRIES     3           /* retransmissions before giving up on a destination */
+#define ARP_NEGATIVE_MS 20000L      /* how long a failed destination is negatively cached */
+#define POLL_IDLE       8           /* calls finding nothing before receive_dgrams() backs off */
+
 #ifdef TRACE
   #define TRACE_ENTRIES 1000
 #else
@@ -76,16 +97,44 @@
 /*
  *  structures
  */
+typedef struct {                    /* dgram queue with constant-time append */
+    IP_DGRAM *head;
+    IP_DGRAM *tail;                     /* only valid if head is not NULL */
+    int32 length;
+} DGRAM_QUEUE;
+
+typedef struct {                    /* destination awaiting address resolution */
+    uint32 ip_addr;                     /* next hop (0 => entry is free) */
+    int32 requested;                    /* TIMER_now() when ARP request last sent, or when failed */
+    int32 timeout;                      /* ms until retransmission */
+    int16 retries;                      /* retransmissions so far */
+    int16 failed;                       /* TRUE => negatively cached, queue is empty */
+    DGRAM_QUEUE queue;                  /* dgrams waiting for it */
+} ARP_PENDING_ENTRY;
+
 struct extended_port {              /* extended PORT structure */
     PORT port;                          /* MUST be first entry in structure, so we can cast the address */
     long magic;                         /* for verification */
 #define EXTPORT_MAGIC   0x01071867L
-    IP_DGRAM *arpwait;                  /* queue for dgrams waiting for address resolution */
+    ARP_PENDING_ENTRY pending[ARP_PENDING]; /* dgrams waiting for address resolution, by next hop */
+    int32 arpwait;                      /* total dgrams waiting for address resolution */
+    uint32 gateway;                     /* last gateway used (its ARP cache entry is pinned) */
+    IP_DGRAM *receive_tail;             /* last dgram we appended to port.receive */
+    int32 receive_depth;                /* dgrams appended since port.receive was last empty */
+    int32 tx_pending;                   /* frames written but not yet flushed */
+    uint32 next_poll;                   /* hz_200 before which receive_dgrams() does not read */
+    int32 poll_ticks;                   /* current interval between reads (0 => every call) */
+    int32 poll_max;                     /* maximum interval */
+    int16 idle_polls;                   /* consecutive calls that found nothing (max POLL_IDLE) */
+    int32 rx_packets;                   /* receive_dgrams() budget per call: packets, */
+    int32 rx_bytes;                     /*  and bytes */
     char unused;
     char interface_up;
+    char announce;                      /* TRUE => arp_timer() must call arp_announce() */
     char hwaddr[ETH_ALEN];              /* set from hardware */
     char macaddr[ETH_ALEN];             /* initially the same as hwaddr[], updated by CTL_ETHER_SET_MAC */
     USBNET_STATS stats;
+    int32 stats_start;                  /* TIMER_now() when stats were last cleared */
     char name[16];
 #ifdef TRACE
     struct {                            /* trace table */
@@ -99,8 +148,16 @@ struct extended_port {              /* extended PORT structure */
 
 /*
  * USB API
+ *
+ * The chip backends are not given the USB stack's API directly, but a
+ * copy of it (usbnet_api) with usb_bulk_msg() & usb_submit_int_msg()
+ * replaced by wrappers that account for every data transfer.  This lets us measure USB traffic
+ * per packet without touching the backends.
  */
 static struct usb_module_api *api;
+static struct usb_module_api usbnet_api;
+#undef usb_bulk_msg                     /* we need the structure member names */
+#undef usb_submit_int_msg
 static struct ueth_data ueth_dev;
 
 /*
@@ -123,12 +180,26 @@ static struct ueth_data ueth_dev;
  *  internal function prototypes
  */
 static void *allocmem(long size);
+static void arp_announce(struct extended_port *x);
+static ARP_PENDING_ENTRY *arp_resolve(struct extended_port *x,uint32 next_hop);
+static void arp_resolved(struct extended_port *x,uint32 ip_addr);
+static void cdecl arp_timer(void);
+static int16 arp_wait(struct extended_port *x,IP_DGRAM *dgram,uint32 next_hop);
+static void *alloc_block(struct extended_port *x,int32 size);
 static int16 close_device(struct extended_port *x);
-static int16 control_device(PORT *port,uint32 argument,int16 code);
+static int16 control_device(PORT *port,uaddr argument,int16 code);
 static IP_DGRAM *dequeue_dgram(IP_DGRAM **queue);
+static void *device_buffer(void);
+static int16 bucket(int32 value,int16 buckets);
+static void discard_dgram(struct extended_port *x,IP_DGRAM *dgram);
 static void display_message(char *s);
 static void empty_queue(IP_DGRAM **queue);
+static ARP_PENDING_ENTRY *find_pending(struct extended_port *x,uint32 ip_addr);
+static void flush_device(struct extended_port *x);
+static void free_pending(struct extended_port *x,ARP_PENDING_ENTRY *entry);
+static int32 get_config(char *name,int32 dflt);
 static int16 get_mac_address(struct extended_port *x,char *macaddr);
+static int32 get_cpu_cookie(void);
 static int32 get_frb_cookie(void);
 static int32 get_sting_cookie(void);
 static int32 get_usb_cookie(void);
@@ -136,31 +207,46 @@ static void init_ext_port(struct extended_port *x);
 static void install(BASPAG *);
 static int16 open_device(struct extended_port *x);
 static int16 process_arp(struct extended_port *x,ARP *arp);
-static int16 process_ip(struct extended_port *x,IP_HDR *ip_hdr,int length);
-static int16 process_output(struct extended_port *x,IP_DGRAM *dgram);
-static void queue_dgram(IP_DGRAM **queue,IP_DGRAM *dgram);
+static int16 process_ip(struct extended_port *x,IP_HDR *ip_hdr,int16 length);
+static int16 process_output(struct extended_port *x,IP_DGRAM *dgram,uint32 *next_hop);
+static void queue_dgram(DGRAM_QUEUE *queue,IP_DGRAM *dgram);
+static long queue_length(IP_DGRAM *queue);
+static void queue_receive(struct extended_port *x,IP_DGRAM *dgram);
 static void quit(char *s);
-static int16 read_device(struct extended_port *x,ENET_PACKET *sp);
+static int16 read_device(struct extended_port *x,ENET_PACKET **pkt);
 static void receive_dgrams(PORT *port);
 static int16 send_arp(struct extended_port *x);
+static int16 send_arp_request(struct extended_port *x,uint32 ip_addr,char *ether);
 static void send_dgrams(PORT *port);
 static int16 set_device_state(PORT *port,int16 state);
-static int16 write_device(struct extended_port *x,char *buffer,int length);
+static IP_DGRAM *unqueue_dgram(DGRAM_QUEUE *queue);
+static ENET_PACKET *write_buffer(struct extended_port *x);
+static int16 write_device(struct extended_port *x,char *buffer,int16 length);
 
 #ifdef TRACE
-static void trace(struct extended_port *x,char type,long rc,int length,char *data);
+static void trace(struct extended_port *x,char type,int32 rc,int16 length,char *data);
 static void trace_init(struct extended_port *x);
 #else
 #define trace(a,b,c,d,e)
 #define trace_init(a)
 #endif
 
+#ifdef PROFILE
+static uint32 fine_clock(void);
+static int32 fine_elapsed(uint32 start);
+#else
+#define fine_clock()    0L
+#define fine_elapsed(a) ((void)(a),0L)
+#endif
+
 #define min(a,b)    ((a)<(b)?(a):(b))
 
 /*
  *  the key STinG variables
  */
-int16 arpcache_entries = 0;         /* returned by arp_init() */
+int16 arpcache_entries = 0;         /* returned by arp_setup() */
+extern unsigned long memcpy_bytes;  /* maintained by memcpy() in utility.c */
+extern void copy_init(long cpu);    /* selects the copy routines in utility.c */
 
 struct extended_port *xbase;        /* ptr to extended port structure */
 
@@ -192,12 +278,16 @@ static ARP_PACKET arp_enet_pkt;
 
 /*
  *  Ethernet packet sent for IP.  Ethernet header, IP header, IP options and
- *  IP data of STinG IP datagrams get copied here one after the other.
+ *  IP data of STinG IP datagrams get copied one after the other into the
+ *  transmit buffer of the device, so the device need not copy them again.
+ *  This is only used if there is no device.
  */
 static ENET_PACKET op;
 
 /*
- *  Input packet
+ *  Input packet.  The Asix driver normally hands back a pointer into its
+ *  own receive buffer, so this is only used for packets that must be
+ *  copied (PicoWifi, or Asix packets that wrap within the receive buffer).
  */
 static ENET_PACKET ip;
 
@@ -216,6 +306,10 @@ static unsigned char mac[ETH_ALEN];
 static int asix_found = 0;
 static int picowifi_found = 0;
 
+static long _cdecl counted_bulk_msg(struct usb_device *dev, unsigned long pipe,
+                        void *data, long len, long *actual_length, long timeout, long flags);
+static long _cdecl counted_int_msg(struct usb_device *dev, unsigned long pipe,
+                        void *buffer, long transfer_len, long interval);
 static long ethernet_probe(struct usb_device *dev, unsigned short ifnum);
 static long ethernet_disconnect(struct usb_device *dev);
 static long ethernet_ioctl(struct uddif *, short, long);
@@ -248,8 +342,8 @@ static long ethernet_probe(struct usb_device *dev, unsigned short ifnum)
 
     old_async = usb_disable_asynch(1);  /* asynch transfer not allowed */
 
-    asix_eth_before_probe(api);
-    picowifi_eth_before_probe(api);
+    asix_eth_before_probe(&usbnet_api);
+    picowifi_eth_before_probe(&usbnet_api);
     if (asix_eth_probe(dev, ifnum, &ueth_dev)) {
         if (asix_eth_get_info(dev, &ueth_dev, mac)) {
             if (xbase != NULL) {
@@ -286,6 +380,64 @@ static long ethernet_ioctl(struct uddif *u, short cmd, long arg)
     return 0L;
 }
 
+/*
+ *  wrapper for usb_bulk_msg(): passes the request on to the USB stack
+ *  and updates the USB transfer counts
+ *
+ *  note: if no data is available, a bulk-in transfer returns -1; this
+ *  is counted as an empty transfer rather than as an error
+ */
+static long _cdecl counted_bulk_msg(struct usb_device *dev, unsigned long pipe,
+                        void *data, long len, long *actual_length, long timeout, long flags)
+{
+long rc;
+
+    rc = (*api->usb_bulk_msg)(dev,pipe,data,len,actual_length,timeout,flags);
+
+    if (!xbase)
+        return rc;
+
+    if (usb_pipein(pipe))
+    {
+        xbase->stats.usb.bulk_in++;
+        if ((rc == 0L) && (*actual_length > 0L))
+            xbase->stats.usb.bulk_in_bytes += *actual_length;
+        else if ((rc == 0L) || (rc == -1L))
+            xbase->stats.usb.bulk_in_empty++;
+        else xbase->stats.usb.bulk_errors++;
+    }
+    else
+    {
+        xbase->stats.usb.bulk_out++;
+        if (rc == 0L)
+            xbase->stats.usb.bulk_out_bytes += *actual_length;
+        else xbase->stats.usb.bulk_errors++;
+    }
+
+    return rc;
+}
+
+/*
+ *  wrapper for usb_submit_int_msg(): passes the request on to the USB
+ *  stack and updates the USB transfer counts
+ */
+static long _cdecl counted_int_msg(struct usb_device *dev, unsigned long pipe,
+                        void *buffer, long transfer_len, long interval)
+{
+long rc;
+
+    rc = (*api->usb_submit_int_msg)(dev,pipe,buffer,transfer_len,interval);
+
+    if (!xbase)
+        return rc;
+
+    xbase->stats.usb.int_in++;
+    if (rc != 0L)
+        xbase->stats.usb.int_errors++;
+
+    return rc;
+}
+
 
 /************************************
 *                                   *
@@ -328,6 +480,12 @@ long PgmSize;
     if (!api)
         quit(NOUSBCOOKIE);
 
+    copy_init(Supexec(get_cpu_cookie)); /* no cookie => 68000 */
+
+    usbnet_api = *api;                  /* must be set up before any probe */
+    usbnet_api.usb_bulk_msg = counted_bulk_msg;
+    usbnet_api.usb_submit_int_msg = counted_int_msg;
+
     if (udd_register(&eth_uif))
         quit(NOREGISTER);
 
@@ -347,6 +505,11 @@ int32 *p;
     return 0L;
 }
 
+static int32 get_cpu_cookie(void)
+{
+    return get_cookie(CPU_COOKIE);
+}
+
 static int32 get_frb_cookie(void)
 {
     return get_cookie(FRB_COOKIE);
@@ -377,6 +540,7 @@ DRIVER *driver;
      */
     xbase = allocmem(sizeof(struct extended_port)); /* get memory for one device */
     init_ext_port(xbase);               /* initialise extended port structure */
+    xbase->stats_start = TIMER_now();
     memcpy(xbase->hwaddr,mac,ETH_ALEN);
     memcpy(xbase->macaddr,mac,ETH_ALEN);
     ports->next = &xbase->port;         /* add port to end of chain */
@@ -402,7 +566,14 @@ DRIVER *driver;
     arp_enet_pkt.arp.hardware_len = ETH_ALEN;
     arp_enet_pkt.arp.protocol_len = 4;
 
-    arpcache_entries = arp_init();
+    arpcache_entries = arp_setup((int16)min(get_config(ARP_ENTRIES_VAR,ARP_ENTRIES),32767L),allocmem);
+
+    ueth_dev.tx_batch = get_config(TX_BATCH_VAR,TX_BATCH);
+    xbase->poll_max = get_config(POLL_MAX_VAR,POLL_MAX) / 5L;   /* in 200Hz ticks */
+    xbase->rx_packets = get_config(RX_PACKETS_VAR,RX_PACKETS);
+    xbase->rx_bytes = get_config(RX_BYTES_VAR,RX_BYTES);
+
+    TIMER_call(arp_timer,HNDLR_SET);    /* for ARP retransmission */
 }
 
 static void *allocmem(long size)
@@ -415,6 +586,31 @@ static long frb = -1;
     return frb?(void *)Mxalloc(size,3):(void *)Malloc(size);
 }
 
+/*
+ *  get the numeric value of a STinG configuration variable
+ *
+ *  returns the default if the variable is not set, or is not a
+ *  positive decimal number (getvstr() returns "0" for variables that
+ *  are not set, so 0 cannot be used as a value)
+ */
+static int32 get_config(char *name,int32 dflt)
+{
+char *p;
+int32 value = 0L;
+
+    p = getvstr(name);
+    if (!p)
+        return dflt;
+
+    while((*p >= '0') && (*p <= '9'))
+        value = value * 10 + (*p++ - '0');
+
+    if (*p || (value <= 0L))
+        return dflt;
+
+    return value;
+}
+
 static void display_message(char *s)
 {
     while(*s)
@@ -476,6 +672,8 @@ static void send_dgrams(PORT *port)
 struct extended_port *x = (struct extended_port *)port;
 IP_DGRAM *dgram;
 int16 length;
+int32 n = 0L;
+uint32 start, t, next_hop;
 
     /* do nothing if it is not for this port */
     if ((x->magic != EXTPORT_MAGIC) || !port->active)
@@ -485,67 +683,113 @@ int16 length;
     if (!port->send)
         return;
 
+    start = fine_clock();
+
     /*
      *  we need to send a datagram
      */
     while((dgram=dequeue_dgram(&port->send)))       /* process entire queue */
     {
+        n++;
         x->stats.send.dequeued++;
-        switch(length=process_output(x,dgram)) {
+        t = fine_clock();
+        length = process_output(x,dgram,&next_hop);
+        x->stats.ticks.output += fine_elapsed(t);
+        switch(length) {
         case 0:
             /*
              * we couldn't send the dgram, so we need to requeue it.  we queue
-             * it to our own queue of dgrams waiting for address resolution.
-             * this queue is processed in process_arp() whenever we get an
-             * ARP response.
+             * it to our own queue of dgrams waiting for resolution of its
+             * next hop.  this queue is processed in process_arp() when we
+             * get ARP information for that address.
              */
-            queue_dgram(&x->arpwait,dgram);
-            x->stats.arp.wait_queued++;
-            break;
+            if (arp_wait(x,dgram,next_hop) == 0)
+            {
+                x->stats.arp.wait_queued++;
+                break;
+            }
+            /* else drop through */
         case -1:
-            IP_discard(dgram,TRUE);
+            discard_dgram(x,dgram);
             port->stat_dropped++;
             break;
         default:
-            IP_discard(dgram,TRUE);
+            discard_dgram(x,dgram);
             port->stat_sd_data += length;
             break;
         }
     }
+
+    flush_device(x);                    /* send whatever has been batched */
+
+    if (n)
+    {
+        x->stats.profile.tx_burst[bucket(n>>1,USBNET_BURST_BUCKETS)]++;
+        x->idle_polls = 0;              /* expect a reply: read on every call */
+        x->poll_ticks = 0L;
+    }
+    if (n > x->stats.queue.send_max)
+        x->stats.queue.send_max = n;
+
+    x->stats.ticks.send += fine_elapsed(start);
 }
 
 /*
- *  receives all pending datagrams and queues them
+ *  receives pending datagrams and queues them
+ *
+ *  to keep the time spent here bounded under load, at most rx_packets
+ *  packets or rx_bytes bytes are received per call: any further packets
+ *  remain buffered (in the adapter or the chip backend) until the next call
  */
 static void receive_dgrams(PORT *port)
 {
 struct extended_port *x = (struct extended_port *)port;
+ENET_PACKET *pkt;
 int16 length;
 int rc = 0;
+int32 n = 0L, bytes = 0L;
+uint32 start, t;
 
     /* do nothing if it is not for this port */
     if ((x->magic != EXTPORT_MAGIC) || !port->active)
         return;
 
-    while((length=read_device(x,&ip)) > 0)
+    /*
+     *  when the link is idle, we don't read on every call (see below)
+     */
+    if (x->poll_ticks && ((int32)(hz_200 - x->next_poll) < 0L))
+    {
+        x->stats.poll.skipped++;
+        return;
+    }
+
+    start = fine_clock();
+
+    while((length=read_device(x,&pkt)) > 0)
     {
+        n++;
+        bytes += length;
         x->stats.receive.total_packets++;
-        switch(ip.eh.type) {
+        x->stats.profile.rx_size[bucket(length>>7,USBNET_SIZE_BUCKETS)]++;
+        switch(pkt->eh.type) {
         case ENET_TYPE_IP:
             x->stats.receive.good_packets++;
-            if (memcmp(ip.eh.destination,BROADCAST_ADDR,ETH_ALEN) == 0)
+            if (memcmp(pkt->eh.destination,BROADCAST_ADDR,ETH_ALEN) == 0)
             {
                 x->stats.process.broadcast_ip_packets++;
                 break;
             }
             x->stats.process.normal_ip_packets++;
-            if ((rc=process_ip(x,(IP_HDR *)ip.ed,length)) != 0)
+            t = fine_clock();
+            rc = process_ip(x,(IP_HDR *)pkt->ed,length);
+            x->stats.ticks.ip += fine_elapsed(t);
+            if (rc != 0)
                 x->stats.process.bad_ip_packets++;
             break;
         case ENET_TYPE_ARP:
             x->stats.receive.good_packets++;
             x->stats.process.arp_packets++;
-            if ((rc=process_arp(x,(ARP *)ip.ed)) != 0)
+            if ((rc=process_arp(x,(ARP *)pkt->ed)) != 0)
                 x->stats.process.bad_arp_packets++;
             break;
         default:
@@ -557,7 +801,40 @@ int rc = 0;
         if (rc == 0)
             port->stat_rcv_data += length;
         else port->stat_dropped++;
+
+        if ((n >= x->rx_packets) || (bytes >= x->rx_bytes))
+        {
+            x->stats.poll.budget_exhausted++;   /* leave the rest for next time */
+            break;
+        }
+    }
+
+    flush_device(x);                    /* send any ARP replies & released dgrams */
+
+    /*
+     *  adaptive polling: once POLL_IDLE consecutive calls have found
+     *  nothing, the interval between reads is doubled after each further
+     *  call that finds nothing, up to poll_max.  a packet received (or
+     *  sent) restores reading on every call.
+     */
+    if (n)
+    {
+        x->idle_polls = 0;
+        x->poll_ticks = 0L;
     }
+    else
+    {
+        x->stats.poll.empty++;
+        if (x->idle_polls < POLL_IDLE)
+            x->idle_polls++;
+        else x->poll_ticks = min(x->poll_ticks?x->poll_ticks<<1:1L,x->poll_max);
+    }
+    x->next_poll = hz_200 + x->poll_ticks;
+
+    if (n)
+        x->stats.profile.rx_burst[bucket(n>>1,USBNET_BURST_BUCKETS)]++;
+
+    x->stats.ticks.receive += fine_elapsed(start);
 }
 
 
@@ -586,7 +863,7 @@ struct extended_port *x = (struct extended_port *)port;
 }
 
 
-static int16 control_device(PORT *port,uint32 argument,int16 code)
+static int16 control_device(PORT *port,uaddr argument,int16 code)
 {
 struct extended_port *x = (struct extended_port *)port;
 int16 result = E_NORMAL;
@@ -611,21 +888,55 @@ static int16 type = -1;
     case CTL_ETHER_GET_TYPE:
         *((int16 *) argument) = type;
         break;
-    case CTL_ETHER_GET_STAT:                /* returns a copy of USBNET_STATS */
+    case CTL_ETHER_GET_STAT:                /* returns a copy of the pre-00.60 part of USBNET_STATS */
+    case CTL_ETHER_GET_XSTAT:               /* returns a copy of USBNET_STATS */
         memcpy(x->stats.hwaddr,x->hwaddr,ETH_ALEN);
         memcpy(x->stats.macaddr,x->macaddr,ETH_ALEN);
         x->stats.arp_entries = arp_count(); /* get entry counts */
+        x->stats.arp_capacity = arpcache_entries;
         x->stats.trace_entries = TRACE_ENTRIES;
-        *((USBNET_STATS *)argument) = x->stats;
+        x->stats.framing.wrapped = ueth_dev.rx_wrapped;
+        x->stats.framing.resets = ueth_dev.rx_resets;
+        x->stats.framing.resyncs = ueth_dev.rx_resyncs;
+        x->stats.usb.bulk_in_skipped = ueth_dev.rx_skipped;
+        x->stats.usb.link_changes = ueth_dev.link_changes;
+        x->stats.poll.interval = x->poll_ticks * 5L;
+        x->stats.poll.max_interval = x->poll_max * 5L;
+        x->stats.resolve.cache_expired = arp_expired;
+        x->stats.resolve.cache_evicted = arp_evicted;
+        x->stats.resolve.cache_lookups = arp_lookups;
+        x->stats.resolve.cache_fast_hits = arp_fast_hits;
+        x->stats.resolve.cache_probes = arp_probes;
+        x->stats.queue.send = queue_length(port->send);
+        x->stats.queue.receive = queue_length(port->receive);
+        x->stats.queue.arpwait = x->arpwait;
+        x->stats.profile.copied_bytes = memcpy_bytes;
+        x->stats.profile.elapsed = TIMER_elapsed(x->stats_start);
+#ifdef PROFILE
+        x->stats.ticks.hz = TIMER_C_HZ;
+#endif
+        if (code == CTL_ETHER_GET_XSTAT)
+            *((USBNET_STATS *)argument) = x->stats;
+        else memcpy((char *)argument,(char *)&x->stats,offsetof(USBNET_STATS,arp_capacity));
         break;
     case CTL_ETHER_CLR_STAT:                /* sets all entries in USBNET_STATS to 0 */
         memset((char *)&x->stats,0,sizeof(USBNET_STATS));
+        ueth_dev.rx_wrapped = ueth_dev.rx_resets = ueth_dev.rx_resyncs = 0L;
+        ueth_dev.rx_skipped = ueth_dev.link_changes = 0L;
+        memcpy_bytes = 0UL;
+        arp_expired = arp_evicted = 0L;
+        arp_lookups = arp_fast_hits = arp_probes = 0L;
+        x->stats_start = TIMER_now();
         break;
     case CTL_ETHER_GET_ARPTABLE:            /* returns ARP table */
         arp_table((ARP_INFO *)argument);
         break;
+    case CTL_ETHER_GET_XARPTABLE:           /* returns ARP table, with flags & ages */
+        arp_xtable((ARP_XINFO *)argument);
+        break;
     case CTL_ETHER_CLR_ARPTABLE:            /* clears ARP table */
         arp_init();
+        x->gateway = 0L;                    /* so it will be pinned again */
         break;
 #ifdef TRACE
     case CTL_ETHER_GET_TRACE:               /* returns trace table */
@@ -668,26 +979,67 @@ IP_DGRAM *dgram;
 }
 
 /*
- *  queue dgram to specified queue
+ *  dequeue the first unexpired dgram from one of our own queues
  */
-static void queue_dgram(IP_DGRAM **queue,IP_DGRAM *dgram)
+static IP_DGRAM *unqueue_dgram(DGRAM_QUEUE *queue)
 {
-IP_DGRAM *walk, **prevptr;
+IP_DGRAM *dgram;
+
+    while((dgram=queue->head))
+    {
+        queue->head = dgram->next;
+        queue->length--;
+        if (check_dgram_ttl(dgram) == E_NORMAL) /* if expired, discard & try again */
+            return dgram;
+    }
 
-    for (walk = *(prevptr=queue); walk; walk = *(prevptr=&walk->next))
-        ;
-    *prevptr = dgram;
+    return NULL;
+}
+
+/*
+ *  append a dgram to one of our own queues
+ */
+static void queue_dgram(DGRAM_QUEUE *queue,IP_DGRAM *dgram)
+{
+    dgram->next = NULL;
+    if (queue->head)
+        queue->tail->next = dgram;
+    else queue->head = dgram;
+    queue->tail = dgram;
+    queue->length++;
+}
+
+/*
+ *  append a dgram to STinG's receive queue
+ *
+ *  STinG removes dgrams from the head of this queue, so the last dgram
+ *  we appended remains the tail until the queue becomes empty
+ */
+static void queue_receive(struct extended_port *x,IP_DGRAM *dgram)
+{
     dgram->next = NULL;
+    if (x->port.receive)
+        x->receive_tail->next = dgram;
+    else
+    {
+        x->port.receive = dgram;
+        x->receive_depth = 0L;
+    }
+    x->receive_tail = dgram;
+
+    if (++x->receive_depth > x->stats.queue.receive_max)
+        x->stats.queue.receive_max = x->receive_depth;
 }
 
 /*
  *  process one output IP packet
  *      returns >0 if packet ok, sent (value is length of packet)
- *              0 if packet ok, not sent
+ *              0 if packet ok, not sent (*next_hop is the address to resolve)
  *          or -1 if error
  */
-static int16 process_output(struct extended_port *x,IP_DGRAM *dgram)
+static int16 process_output(struct extended_port *x,IP_DGRAM *dgram,uint32 *next_hop)
 {
+ENET_PACKET *op;
 char *cachedEther;
 int16 enet_length;
 uint32 network, ip_address;
@@ -731,32 +1083,41 @@ uint32 network, ip_address;
     if (!(cachedEther=arp_cache(ip_address)))
     {
         /*
-         * the ethernet address is NOT in the cache: we must send an ARP query.
+         * the ethernet address is NOT in the cache: the caller must queue
+         * the dgram with arp_wait(), which sends an ARP query if necessary
          */
-        memset(arp_enet_pkt.eh.destination,0xff,ETH_ALEN);  /* broadcast */
-        arp_enet_pkt.arp.op_code = ARP_OP_REQ;              /* we send a request */
-        memset(arp_enet_pkt.arp.dest_ether,0xff,ETH_ALEN);  /* broadcast */
-        arp_enet_pkt.arp.dest_ip = ip_address;
-        send_arp(x);
+        *next_hop = ip_address;
         return 0;                   /* dgram ok, we just didn't send it */
     }
 
+    /*
+     *  we keep the gateway's ARP cache entry pinned, so it is never evicted
+     */
+    if ((ip_address != dgram->hdr.ip_dest) && (ip_address != x->gateway))
+    {
+        if (x->gateway)
+            arp_pin(x->gateway,FALSE);
+        arp_pin(ip_address,TRUE);
+        x->gateway = ip_address;
+    }
+
     /*
      *  we've found the ethernet address in the cache, so we try to send the dgram
      */
-    memcpy(op.eh.destination,cachedEther,ETH_ALEN);
-    memcpy(op.eh.source,x->macaddr,ETH_ALEN);
-    op.eh.type = ENET_TYPE_IP;
-    memcpy(op.ed,(char *)&dgram->hdr,sizeof(IP_HDR));
-    memcpy(op.ed+sizeof(IP_HDR),dgram->options,dgram->opt_length);
-    memcpy(op.ed+sizeof(IP_HDR)+dgram->opt_length,dgram->pkt_data,dgram->pkt_length);
+    op = write_buffer(x);
+    memcpy(op->eh.destination,cachedEther,ETH_ALEN);
+    memcpy(op->eh.source,x->macaddr,ETH_ALEN);
+    op->eh.type = ENET_TYPE_IP;
+    memcpy(op->ed,(char *)&dgram->hdr,sizeof(IP_HDR));
+    memcpy(op->ed+sizeof(IP_HDR),dgram->options,dgram->opt_length);
+    memcpy(op->ed+sizeof(IP_HDR)+dgram->opt_length,dgram->pkt_data,dgram->pkt_length);
     if (enet_length < ETH_MIN_LEN)
     {
-        memset(op.ed+sizeof(IP_HDR)+dgram->opt_length+dgram->pkt_length,0,ETH_MIN_LEN-enet_length);
+        memset(op->ed+sizeof(IP_HDR)+dgram->opt_length+dgram->pkt_length,0,ETH_MIN_LEN-enet_length);
                                                             /* pad with zeros (for neatness) */
         enet_length = ETH_MIN_LEN;
     }
-    if (write_device(x,(char *)&op,enet_length) != 0)
+    if (write_device(x,(char *)op,enet_length) != 0)
         return -1;
     x->stats.send.ip_packets++;
 
@@ -768,9 +1129,9 @@ uint32 network, ip_address;
  *      returns 0 if packet accepted
  *          or -1 if error
  */
-static int16 process_ip(struct extended_port *x,IP_HDR *ip_hdr,int length)
+static int16 process_ip(struct extended_port *x,IP_HDR *ip_hdr,int16 length)
 {
-IP_DGRAM *dgram, *walk, **prevptr;
+IP_DGRAM *dgram;
 char *p;
 
     if ((length < ETH_MIN_LEN) || (length > ETH_MAX_LEN))   /* validate total packet length */
@@ -781,18 +1142,18 @@ char *p;
      || (ip_hdr->hd_len*4 > ip_hdr->length))
         return -1;
 
-    if ((dgram=KRmalloc(sizeof(IP_DGRAM))) == NULL)
+    if ((dgram=alloc_block(x,sizeof(IP_DGRAM))) == NULL)
         return -1;
 
     memcpy((char *)&dgram->hdr,ip_hdr,sizeof(IP_HDR));
 
     dgram->opt_length = (int16)(ip_hdr->hd_len*4 - sizeof(IP_HDR));
-    dgram->options = KRmalloc(dgram->opt_length);
+    dgram->options = alloc_block(x,dgram->opt_length);
     dgram->pkt_length = ip_hdr->length - ip_hdr->hd_len*4;
-    dgram->pkt_data = KRmalloc(dgram->pkt_length);
+    dgram->pkt_data = alloc_block(x,dgram->pkt_length);
     if (!dgram->options || !dgram->pkt_data)
     {
-        IP_discard(dgram,TRUE);
+        discard_dgram(x,dgram);
         return -1;
     }
     p = ((char *)ip_hdr) + sizeof(IP_HDR);
@@ -803,9 +1164,7 @@ char *p;
     dgram->recvd = &x->port;
     dgram->next = NULL;
     set_dgram_ttl(dgram);
-    for (walk = *(prevptr = &x->port.receive); walk; walk = *(prevptr = &walk->next))
-        ;
-    *prevptr = dgram;
+    queue_receive(x,dgram);
 
     return 0;
 }
@@ -817,11 +1176,6 @@ char *p;
  */
 static int16 process_arp(struct extended_port *x,ARP *arp)
 {
-IP_DGRAM *dgram;
-IP_DGRAM *arptemp = NULL;
-char *cachedEther;
-int16 length;
-
     /* ignore funny ARP packets */
     if ((arp->hardware_space != ARP_HARD_ETHER)
      || (arp->hardware_len != ETH_ALEN)
@@ -843,14 +1197,16 @@ int16 length;
     }
 
     /*
-     * check if this ether source is in the cache
+     * update the cache from this ARP info
      *
-     * note that we update the cache when we see _any_ ARP info: this
-     * should reduce the number of ARP requests we have to make
+     * as per RFC 826, we update an existing entry from _any_ ARP packet,
+     * but only add a new entry if the packet was addressed to us, or if
+     * we are waiting for that address.  so ARP traffic between other
+     * hosts on a busy LAN does not churn the cache.
      */
-    if ((cachedEther=arp_cache(arp->src_ip)) == NULL)
-        arp_enter(arp->src_ip,arp->src_ether);
-    else memcpy(cachedEther,arp->src_ether,ETH_ALEN);
+    if (!arp_update(arp->src_ip,arp->src_ether))
+        if ((arp->dest_ip == x->port.ip_addr) || find_pending(x,arp->src_ip))
+            arp_enter(arp->src_ip,arp->src_ether);
 
     /*
      * if this was a request to us, we'd better answer
@@ -871,40 +1227,308 @@ int16 length;
     }
 
     /*
-     * we have some (potentially) new ARP information, so we process
-     * the dgrams that are queued waiting for address resolution.
+     * we have some (potentially) new ARP information, so we send any
+     * dgrams that are waiting for resolution of this address
+     */
+    arp_resolved(x,arp->src_ip);
+
+    return 0;
+}
+
+/*
+ *  start resolution of an address, if it is not already under way
+ *
+ *  the first request for a destination causes an ARP request to be
+ *  sent; any retransmission is done by arp_timer().  if the pending
+ *  table is full, the destination that was requested longest ago is
+ *  evicted, and its dgrams discarded.
+ *      returns a pointer to the pending table entry,
+ *          or NULL if the address recently failed to resolve
+ */
+static ARP_PENDING_ENTRY *arp_resolve(struct extended_port *x,uint32 next_hop)
+{
+ARP_PENDING_ENTRY *p, *entry = NULL, *oldest = NULL;
+int16 i;
+
+    for (i = 0, p = x->pending; i < ARP_PENDING; i++, p++)
+    {
+        if (p->ip_addr == next_hop)
+            break;
+        if (!p->ip_addr)
+        {
+            if (!entry)
+                entry = p;
+        }
+        else if (!oldest || (TIMER_elapsed(p->requested) > TIMER_elapsed(oldest->requested)))
+            oldest = p;
+    }
+
+    if (i < ARP_PENDING)            /* destination already known */
+    {
+        entry = p;
+        if (entry->failed)
+        {
+            if (TIMER_elapsed(entry->requested) < ARP_NEGATIVE_MS)
+            {
+                x->stats.resolve.negative_hits++;
+                return NULL;
+            }
+            free_pending(x,entry);  /* negative entry has expired: try again */
+        }
+    }
+    else if (!entry)                /* table full: evict oldest */
+    {
+        entry = oldest;
+        free_pending(x,entry);
+        x->stats.resolve.pending_evicted++;
+    }
+
+    if (!entry->ip_addr)            /* new destination: start resolution */
+    {
+        entry->ip_addr = next_hop;
+        entry->requested = TIMER_now();
+        entry->timeout = ARP_TIMEOUT_MS;
+        send_arp_request(x,next_hop,NULL);
+    }
+
+    return entry;
+}
+
+/*
+ *  queue a dgram to wait for resolution of its next hop
+ *
+ *  subsequent dgrams for the same destination just join the queue, so a
+ *  burst of dgrams to an unresolved (or dead) host does not cause a burst
+ *  of ARP requests.  dgrams for a destination that has recently failed to
+ *  resolve are rejected immediately.
+ *      returns 0 if queued
+ *          or -1 if error
+ */
+static int16 arp_wait(struct extended_port *x,IP_DGRAM *dgram,uint32 next_hop)
+{
+ARP_PENDING_ENTRY *entry;
+
+    if (!next_hop)
+        return -1;
+
+    if (!(entry=arp_resolve(x,next_hop)))
+        return -1;
+
+    queue_dgram(&entry->queue,dgram);
+    if (++x->arpwait > x->stats.queue.arpwait_max)
+        x->stats.queue.arpwait_max = x->arpwait;
+
+    return 0;
+}
+
+/*
+ *  announce ourselves on the network when the port comes up: we send
+ *  a gratuitous ARP for our own address, so that peers update their
+ *  caches, and start resolving each gateway on our subnet, so that the
+ *  first dgram routed through it does not have to wait
+ */
+static void arp_announce(struct extended_port *x)
+{
+PORT *port;
+uint32 template, netmask, gateway, network;
+int16 i;
+
+    if ((x->port.ip_addr == 0L) || (x->port.ip_addr == 0xffffffffUL))
+        return;
+
+    send_arp_request(x,x->port.ip_addr,NULL);   /* gratuitous ARP */
+    x->stats.resolve.gratuitous++;
+
+    network = x->port.ip_addr & x->port.sub_mask;
+
+    for (i = 0; i < MAX_ROUTES; i++)
+    {
+        if (get_route_entry(i,&template,&netmask,&port,&gateway) != E_NORMAL)
+            break;
+        if ((port != &x->port) || !gateway)
+            continue;
+        if ((gateway & x->port.sub_mask) != network)
+            continue;
+        if (arp_cache(gateway))
+            continue;
+        if (arp_resolve(x,gateway))
+            x->stats.resolve.gateway_probes++;
+    }
+}
+
+/*
+ *  find the pending table entry for an address
+ */
+static ARP_PENDING_ENTRY *find_pending(struct extended_port *x,uint32 ip_addr)
+{
+ARP_PENDING_ENTRY *p;
+int16 i;
+
+    if (!ip_addr)
+        return NULL;
+
+    for (i = 0, p = x->pending; i < ARP_PENDING; i++, p++)
+        if (p->ip_addr == ip_addr)
+            return p;
+
+    return NULL;
+}
+
+/*
+ *  free a pending table entry, discarding any dgrams still waiting
+ */
+static void free_pending(struct extended_port *x,ARP_PENDING_ENTRY *entry)
+{
+IP_DGRAM *dgram;
+
+    x->arpwait -= entry->queue.length;
+    while((dgram=unqueue_dgram(&entry->queue)))
+    {
+        discard_dgram(x,dgram);
+        x->port.stat_dropped++;
+    }
+
+    entry->ip_addr = 0L;
+    entry->retries = 0;
+    entry->failed = FALSE;
+    entry->queue.head = NULL;
+    entry->queue.length = 0L;
+}
+
+/*
+ *  timer handler, called periodically by STinG
+ *
+ *  retransmits the ARP requests for pending destinations, doubling the
+ *  timeout each time.  after the last retry, the waiting dgrams are
+ *  discarded and the destination is negatively cached for a while.
+ *
+ *  it also does the work requested by open_device(), since that may be
+ *  called in user mode, and the USB API requires supervisor mode.
+ */
+static void cdecl arp_timer(void)
+{
+struct extended_port *x = xbase;
+ARP_PENDING_ENTRY *p;
+char *ether;
+uint32 ip_addr;
+int16 i;
+
+    if (!x || !x->port.active)
+        return;
+
+    if (x->announce)
+    {
+        x->announce = FALSE;
+        arp_announce(x);
+    }
+
+    for (i = 0, p = x->pending; i < ARP_PENDING; i++, p++)
+    {
+        if (!p->ip_addr || p->failed)
+            continue;
+        if (TIMER_elapsed(p->requested) < p->timeout)
+            continue;
+
+        if (p->retries >= ARP_RETRIES)
+        {
+            ip_addr = p->ip_addr;
+            free_pending(x,p);
+            p->ip_addr = ip_addr;       /* keep the entry as a negative cache entry */
+            p->failed = TRUE;
+            p->requested = TIMER_now();
+            x->stats.resolve.timeouts++;
+            continue;
+        }
+
+        p->retries++;
+        p->timeout <<= 1;
+        p->requested = TIMER_now();
+        send_arp_request(x,p->ip_addr,NULL);
+        x->stats.resolve.retries++;
+    }
+
+    /*
+     * refresh (at most) one ARP cache entry that is in use and about to
+     * expire, asking the current owner of the address directly
      */
-    while((dgram=dequeue_dgram(&x->arpwait)))       /* process entire queue */
+    if ((ether=arp_refresh(&ip_addr)) != NULL)
+    {
+        send_arp_request(x,ip_addr,ether);
+        x->stats.resolve.cache_refreshes++;
+    }
+
+    flush_device(x);
+}
+
+/*
+ *  send the dgrams waiting for resolution of the specified address
+ *  (if any), and free the corresponding pending table entry
+ */
+static void arp_resolved(struct extended_port *x,uint32 ip_addr)
+{
+ARP_PENDING_ENTRY *p;
+DGRAM_QUEUE queue;
+IP_DGRAM *dgram;
+uint32 next_hop;
+int16 length;
+
+    if (!(p=find_pending(x,ip_addr)))
+        return;
+
+    queue = p->queue;               /* detach the queue, then free the entry */
+    p->queue.head = NULL;
+    p->queue.length = 0L;
+    free_pending(x,p);
+    x->arpwait -= queue.length;
+
+    while((dgram=unqueue_dgram(&queue)))
     {
         x->stats.arp.wait_dequeued++;
-        switch(length=process_output(x,dgram)) {
+        switch(length=process_output(x,dgram,&next_hop)) {
         case 0:
             /*
-             * we couldn't send the dgram (presumably the ARP info was for
-             * a different address), so we need to requeue it (again).
-             * we queue it off a temporary queue header so that we don't
-             * loop for ever here.
+             * we still couldn't send the dgram (the cache entry may have
+             * been replaced already), so it must wait again
              */
-            queue_dgram(&arptemp,dgram);
-            x->stats.arp.wait_requeued++;
-            break;
+            if (arp_wait(x,dgram,next_hop) == 0)
+            {
+                x->stats.arp.wait_requeued++;
+                break;
+            }
+            /* else drop through */
         case -1:
-            IP_discard(dgram,TRUE);
+            discard_dgram(x,dgram);
             x->port.stat_dropped++;
             break;
         default:
-            IP_discard(dgram,TRUE);
+            discard_dgram(x,dgram);
             x->port.stat_sd_data += length;
             break;
         }
     }
-    /*
-     * the arpwait queue is empty, but there may be entries in the
-     * arptemp queue.  fix this up!
-     */
-    x->arpwait = arptemp;
+}
 
-    return 0;
+/*
+ *  send an ARP request for the specified address, either to the
+ *  specified ether address or (if NULL) broadcast
+ */
+static int16 send_arp_request(struct extended_port *x,uint32 ip_addr,char *ether)
+{
+    if (ether)
+    {
+        memcpy(arp_enet_pkt.eh.destination,ether,ETH_ALEN);
+        memcpy(arp_enet_pkt.arp.dest_ether,ether,ETH_ALEN);
+    }
+    else
+    {
+        memset(arp_enet_pkt.eh.destination,0xff,ETH_ALEN);  /* broadcast */
+        memset(arp_enet_pkt.arp.dest_ether,0xff,ETH_ALEN);
+    }
+    arp_enet_pkt.arp.op_code = ARP_OP_REQ;              /* we send a request */
+    arp_enet_pkt.arp.dest_ip = ip_addr;
+    x->stats.resolve.requests_sent++;
+
+    return send_arp(x);
 }
 
 static int16 send_arp(struct extended_port *x)
@@ -925,6 +1549,57 @@ int16 rc;
     return rc;
 }
 
+/*
+ *  return histogram bucket for value: 0 for 0, 1 for 1, 2 for 2-3,
+ *  3 for 4-7, etc., with all larger values in the last bucket
+ */
+static int16 bucket(int32 value,int16 buckets)
+{
+int16 i;
+
+    for (i = 0; (value > 0L) && (i < buckets-1); i++)
+        value >>= 1;
+
+    return i;
+}
+
+/*
+ *  return number of dgrams in specified queue
+ */
+static long queue_length(IP_DGRAM *queue)
+{
+long n;
+
+    for (n = 0L; queue; queue = queue->next)
+        n++;
+
+    return n;
+}
+
+/*
+ *  allocate a block from STinG's memory pool, updating the memory counts
+ */
+static void *alloc_block(struct extended_port *x,int32 size)
+{
+void *p;
+
+    x->stats.memory.allocs++;
+    if ((p=KRmalloc(size)) == NULL)
+        x->stats.memory.alloc_failures++;
+    else x->stats.memory.alloc_bytes += size;
+
+    return p;
+}
+
+/*
+ *  discard a dgram (including its option & data blocks), updating the memory counts
+ */
+static void discard_dgram(struct extended_port *x,IP_DGRAM *dgram)
+{
+    x->stats.memory.discards++;
+    IP_discard(dgram,TRUE);
+}
+
 static void empty_queue(IP_DGRAM **queue)
 {
 IP_DGRAM *walk, *next;
@@ -948,6 +1623,7 @@ IP_DGRAM *walk, *next;
 static int16 open_device(struct extended_port *x)
 {
     x->interface_up = TRUE;
+    x->announce = TRUE;                 /* done later, by arp_timer() */
 
     return 0;
 }
@@ -959,22 +1635,68 @@ static int16 close_device(struct extended_port *x)
     return 0;
 }
 
+/*
+ *  return the address at which the chip backend will accept the next
+ *  packet, or NULL if its current batch is full
+ */
+static void *device_buffer(void)
+{
+    if (asix_found)
+        return asix_send_buffer(&ueth_dev);
+    if (picowifi_found)
+        return picowifi_send_buffer(&ueth_dev);
+
+    return &op;
+}
+
+/*
+ *  return the buffer in which to build a packet for write_device()
+ *
+ *  this is the device's own transmit buffer, so that write_device()
+ *  need not copy the packet again
+ */
+static ENET_PACKET *write_buffer(struct extended_port *x)
+{
+void *p;
+
+    if (!(p=device_buffer()))
+    {
+        flush_device(x);                /* batch is full: send it first */
+        p = device_buffer();
+    }
+
+    return (ENET_PACKET *)p;
+}
+
 /*
  *  write a packet
  *      returns 0: ok
  *              -1: error
+ *
+ *  packets are batched & not actually sent until flush_device() is
+ *  called: a failure to send is counted there
  */
-static int16 write_device(struct extended_port *x, char *buffer, int length)
+static int16 write_device(struct extended_port *x, char *buffer, int16 length)
 {
 long rc = -1;
+uint32 start = fine_clock();
 
     x->stats.write.total_packets++;
+    x->stats.profile.tx_size[bucket(length>>7,USBNET_SIZE_BUCKETS)]++;
+
+    if (!device_buffer())               /* no room (packet was not built in place) */
+        flush_device(x);
 
     if (asix_found)
         rc = asix_send(&ueth_dev, buffer, length);
     else if (picowifi_found)
         rc = picowifi_send(&ueth_dev, buffer, length);
 
+    if (rc == 0L)
+        x->tx_pending++;
+
+    x->stats.ticks.write += fine_elapsed(start);
+
     trace(x, TRACE_WRITE, rc, length, buffer);
 
     if (rc < 0L)
@@ -986,25 +1708,61 @@ long rc = -1;
     return 0;
 }
 
+/*
+ *  send any packets batched by write_device()
+ */
+static void flush_device(struct extended_port *x)
+{
+long rc = 0L;
+uint32 start;
+
+    if (!x->tx_pending)
+        return;
+
+    start = fine_clock();
+
+    if (asix_found)
+        rc = asix_send_flush(&ueth_dev);
+    else if (picowifi_found)
+        rc = picowifi_send_flush(&ueth_dev);
+
+    x->stats.ticks.write += fine_elapsed(start);
+
+    if (rc < 0L)
+        x->stats.write.failed += x->tx_pending;     /* all were lost */
+    else x->stats.profile.tx_batch[bucket(x->tx_pending>>1,USBNET_BURST_BUCKETS)]++;
+
+    x->tx_pending = 0L;
+}
+
 /*
  *  read a packet
  *      returns >0: length, more to do
  *              0: no more
  *              -1: error
+ *
+ *  on return, *pkt points to the packet; this is only valid until the
+ *  next call
  */
-static int16 read_device(struct extended_port *x,ENET_PACKET *ip)
+static int16 read_device(struct extended_port *x,ENET_PACKET **pkt)
 {
+unsigned char *p = (unsigned char *)&ip;
 long rc = -1;
+uint32 start = fine_clock();
 
     x->stats.read.total_packets++;
 
     if (asix_found)
-        rc = asix_recv(&ueth_dev,(unsigned char *)ip,ETH_MAX_LEN);
+        rc = asix_recv_ptr(&ueth_dev,&p,(unsigned char *)&ip,ETH_MAX_LEN);
     else if (picowifi_found)
-        rc = picowifi_recv(&ueth_dev,(unsigned char *)ip,ETH_MAX_LEN);
+        rc = picowifi_recv_ptr(&ueth_dev,&p,(unsigned char *)&ip,ETH_MAX_LEN);
+
+    x->stats.ticks.read += fine_elapsed(start);
+
+    *pkt = (ENET_PACKET *)p;
 
     if (rc)
-        trace(x,TRACE_READ,rc,rc,(char *)ip);
+        trace(x,TRACE_READ,rc,rc,(char *)p);
 
     if (rc < 0L) {
         x->stats.read.failed++;
@@ -1014,6 +1772,45 @@ long rc = -1;
     return rc;
 }
 
+#ifdef PROFILE
+/*
+ *  fine-grained clock for the profiling counters
+ *
+ *  MFP timer C, which drives hz_200, counts down from TIMER_C_COUNTS to 1
+ *  at 38400Hz.  hz_200 alone is no use for timing our code, because STinG
+ *  calls us in step with it, so a call almost never sees it change.
+ */
+static uint32 fine_clock(void)
+{
+uint32 ticks;
+uint8 count;
+
+    do
+    {
+        ticks = hz_200;
+        count = mfp_tcdr;
+    } while(ticks != hz_200);           /* timer C reloaded while reading */
+
+    return ticks * TIMER_C_COUNTS + (TIMER_C_COUNTS - count);
+}
+
+/*
+ *  timer C counts elapsed since 'start'
+ *
+ *  if we run with the timer C interrupt masked, hz_200 is not updated when
+ *  timer C reloads, so the clock appears to go back one tick
+ */
+static int32 fine_elapsed(uint32 start)
+{
+int32 elapsed = (int32)(fine_clock() - start);
+
+    if (elapsed < 0L)
+        elapsed += TIMER_C_COUNTS;
+
+    return elapsed;
+}
+#endif
+
 /*
  *  get MAC address: callable from user & supervisor mode
  */
@@ -1061,7 +1858,7 @@ int32 i;
 /*
  *  make a trace entry (assumed to be called from supervisor mode)
  */
-static void trace(struct extended_port *x,char type,long rc,int length,char *data)
+static void trace(struct extended_port *x,char type,int32 rc,int16 length,char *data)
 {
 USBNET_TRACE *t;
 
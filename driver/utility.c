@@ -34,12 +34,74 @@
 # define NULL   ((void *)0L)
 #endif
 
+/*
+ * The following block functions carry every packet byte through the
+ * driver, so they work a long at a time where possible.  The 68000
+ * faults on word or long accesses to odd addresses, so on that CPU this
+ * is only done when both addresses have the same parity: the first byte
+ * is then handled separately if necessary, leaving both addresses even.
+ * Short blocks, and blocks whose addresses have different parity, are
+ * handled a byte at a time.
+ *
+ * The 68020 and later handle misaligned accesses in hardware, and the
+ * 68040 & 68060 can also copy 16-byte lines with move16, so copy_init()
+ * selects the best memcpy() kernel for the CPU we are running on.
+ */
+#define SHORT_BLOCK     16      /* blocks shorter than this are done bytewise */
+#define MOVEM_BLOCK     32      /* bytes moved per movem.l pair */
+#define LINE_SIZE       16      /* bytes moved per move16 */
+#define ALTRAM_START    0x01000000L /* move16 needs burst-capable (non-ST) RAM */
+
+#define ODD(p)          ((long)(p) & 1)
+
+typedef void *(*copy_fn_t)(void *dest, const void *source, long n);
+
+static void *copy_68000(void *dest, const void *source, long n);
+static void *copy_68020(void *dest, const void *source, long n);
+static void *copy_68040(void *dest, const void *source, long n);
+
+static copy_fn_t copy_fn = copy_68000;
+static long align_mask = 1;     /* alignment used for long accesses */
+
+/*
+ * select the block function kernels according to the value of the
+ * _CPU cookie (0, 10, 20, 30, 40 or 60)
+ */
+void copy_init(long cpu)
+{
+    if (cpu >= 40)
+        copy_fn = copy_68040;
+    else if (cpu >= 20)
+        copy_fn = copy_68020;
+    else copy_fn = copy_68000;
+
+    align_mask = (cpu >= 20) ? 3 : 1;
+}
+
 int memcmp(const void *s1, const void *s2, long n)
 {
     unsigned char *p = (unsigned char *)s1;
     unsigned char *q = (unsigned char *)s2;
     int r;
 
+    if ((n >= SHORT_BLOCK) && (ODD(p) == ODD(q)))
+    {
+        if (ODD(p))
+        {
+            r = *p++ - *q++;
+            if (r)
+                return r;
+            n--;
+        }
+        /* skip equal longs; the bytewise loop below finds the difference */
+        while ((n >= 4) && (*(unsigned long *)p == *(unsigned long *)q))
+        {
+            p += 4;
+            q += 4;
+            n -= 4;
+        }
+    }
+
     while (n--)
     {
         r = *p++ - *q++;
@@ -50,10 +112,60 @@ int memcmp(const void *s1, const void *s2, long n)
     return 0;
 }
 
+unsigned long memcpy_bytes;     /* instrumentation: total bytes copied */
+
 void *memcpy(void *dest, const void *source, long n)
+{
+    memcpy_bytes += n;
+
+    return (*copy_fn)(dest, source, n);
+}
+
+/*
+ * 68000-safe kernel: longs (and movem.l) only if both addresses
+ * have the same parity
+ */
+static void *copy_68000(void *dest, const void *source, long n)
 {
     char *dst = (char *)dest;
     const char *src = (const char *)source;
+    unsigned long *ldst;
+    const unsigned long *lsrc;
+
+    if ((n >= SHORT_BLOCK) && (ODD(dst) == ODD(src)))
+    {
+        if (ODD(dst))
+        {
+            *dst++ = *src++;
+            n--;
+        }
+        ldst = (unsigned long *)dst;
+        lsrc = (const unsigned long *)src;
+#ifdef __mc68000__
+        if (n >= MOVEM_BLOCK)
+        {
+            unsigned long *end = ldst + (n / MOVEM_BLOCK) * (MOVEM_BLOCK / 4);
+
+            __asm__ volatile
+            (
+                "1:\n\t"
+                "movem.l (%0)+,%%d0-%%d7\n\t"
+                "movem.l %%d0-%%d7,(%1)\n\t"
+                "lea     32(%1),%1\n\t"
+                "cmp.l   %2,%1\n\t"
+                "jcs     1b"
+            : "+a"(lsrc), "+a"(ldst)
+            : "a"(end)
+            : "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7", "cc", "memory"
+            );
+            n &= MOVEM_BLOCK - 1;
+        }
+#endif
+        for ( ; n >= 4; n -= 4)
+            *ldst++ = *lsrc++;
+        dst = (char *)ldst;
+        src = (const char *)lsrc;
+    }
 
     while (n--)
         *dst++ = *src++;
@@ -61,9 +173,105 @@ void *memcpy(void *dest, const void *source, long n)
     return dest;
 }
 
+/*
+ * 68020/68030 kernel: the destination is long-aligned, and the
+ * hardware copes with any misalignment of the source
+ */
+static void *copy_68020(void *dest, const void *source, long n)
+{
+    char *dst = (char *)dest;
+    const char *src = (const char *)source;
+    unsigned long *ldst;
+    const unsigned long *lsrc;
+
+    if (n >= SHORT_BLOCK)
+    {
+        for ( ; (long)dst & 3; n--)
+            *dst++ = *src++;
+        ldst = (unsigned long *)dst;
+        lsrc = (const unsigned long *)src;
+        for ( ; n >= 16; n -= 16)
+        {
+            *ldst++ = *lsrc++;
+            *ldst++ = *lsrc++;
+            *ldst++ = *lsrc++;
+            *ldst++ = *lsrc++;
+        }
+        for ( ; n >= 4; n -= 4)
+            *ldst++ = *lsrc++;
+        dst = (char *)ldst;
+        src = (const char *)lsrc;
+    }
+
+    while (n--)
+        *dst++ = *src++;
+
+    return dest;
+}
+
+/*
+ * 68040/68060 kernel: move16 transfers whole cache lines, but both
+ * addresses must then be line-aligned, so it is only usable if they
+ * are equally misaligned.  ST-RAM does not support the burst accesses
+ * that move16 uses, so it is restricted to alternate RAM.  Otherwise
+ * we use the 68020 kernel.
+ */
+static void *copy_68040(void *dest, const void *source, long n)
+{
+    char *dst = (char *)dest;
+    const char *src = (const char *)source;
+
+    if ((n < 2*LINE_SIZE) || (((long)dst ^ (long)src) & (LINE_SIZE-1))
+     || ((unsigned long)dst < ALTRAM_START) || ((unsigned long)src < ALTRAM_START))
+        return copy_68020(dest, source, n);
+
+    for ( ; (long)dst & (LINE_SIZE-1); n--)
+        *dst++ = *src++;
+
+#ifdef __mc68000__
+    {
+        register const char *s __asm__("a0") = src;
+        register char *d __asm__("a1") = dst;
+        register long lines __asm__("d0") = n / LINE_SIZE;
+
+        __asm__ volatile
+        (
+            "1:\n\t"
+            ".word   0xf620,0x9000\n\t"    /* move16 (a0)+,(a1)+ */
+            "subq.l  #1,%2\n\t"
+            "jne     1b"
+        : "+a"(s), "+a"(d), "+d"(lines)
+        :
+        : "cc", "memory"
+        );
+        src = s;
+        dst = d;
+        n &= LINE_SIZE - 1;
+    }
+#endif
+
+    copy_68020(dst, src, n);
+
+    return dest;
+}
+
 void *memset(void *s, int c, long n)
 {
     char *p = (char *)s;
+    unsigned long *lp;
+    unsigned long fill;
+
+    if (n >= SHORT_BLOCK)
+    {
+        for ( ; (long)p & align_mask; n--)
+            *p++ = c;
+        fill = (unsigned char)c;
+        fill |= fill << 8;
+        fill |= fill << 16;
+        for (lp = (unsigned long *)p; n >= 4; n -= 4)
+            *lp++ = fill;
+        p = (char *)lp;
+    }
 
     while (n--)
         *p++ = c;
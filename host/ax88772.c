@@ -0,0 +1,344 @@
+/*
+ * model of an AX88772B USB ethernet adapter, for the host harness
+ *
+ * Received frames are queued in a FIFO as the chip's bulk-in byte stream:
+ * each frame is preceded by a 4-byte header holding its length and the
+ * complement of its length (little-endian), and padded to an even length.
+ * A bulk-in transfer returns as much of the stream as fits, up to the
+ * burst size programmed into RX_CTL, so frames are split across transfers
+ * just as they are by the chip; a short transfer means the FIFO is empty.
+ *
+ * Bulk-out transfers are parsed the same way and each frame is passed to
+ * the caller's handler; malformed transfers are counted and discarded.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "ax88772.h"
+#include "mii.h"
+
+/* vendor requests (see driver/asix.c) */
+#define AX_CMD_SET_SW_MII           0x06
+#define AX_CMD_READ_MII_REG         0x07
+#define AX_CMD_WRITE_MII_REG        0x08
+#define AX_CMD_SET_HW_MII           0x0a
+#define AX_CMD_READ_EEPROM          0x0b
+#define AX_CMD_READ_RX_CTL          0x0f
+#define AX_CMD_WRITE_RX_CTL         0x10
+#define AX_CMD_WRITE_IPG0           0x12
+#define AX_CMD_READ_NODE_ID         0x13
+#define AX_CMD_READ_PHY_ID          0x19
+#define AX_CMD_WRITE_MEDIUM_MODE    0x1b
+#define AX_CMD_WRITE_GPIOS          0x1f
+#define AX_CMD_SW_RESET             0x20
+#define AX_CMD_SW_PHY_SELECT        0x22
+
+#define AX_RX_CTL_SO        0x0080      /* start operation */
+#define AX_RX_CTL_MFB       0x0300      /* maximum frame burst */
+
+#define AX_PHY_ID           0x10        /* embedded PHY */
+#define AX_TX_PAD           0xffff0000UL
+#define ETH_MAX_LEN         1514
+
+#define EP_INT              1
+#define EP_IN               2
+#define EP_OUT              3
+
+struct ax88772_stats ax88772_stats;
+
+static const unsigned char node_id[6] = { 0x00, 0x0e, 0xc6, 0x88, 0x77, 0x2b };
+
+static unsigned short mii[32];
+static unsigned short rx_ctl;
+static int sw_mii;
+static int link_up;
+static void (*tx_handler)(const unsigned char *frame, long len);
+
+static unsigned char fifo[AX_MODEL_FIFO_MAX];
+static long fifo_size;
+static long fifo_head, fifo_tail;   /* next byte to send, next free byte */
+
+
+void ax88772_reset(long size)
+{
+    memset(&ax88772_stats, 0, sizeof(ax88772_stats));
+    memset(mii, 0, sizeof(mii));
+    mii[MII_BMCR] = BMCR_ANENABLE;
+    mii[MII_PHYSID1] = 0x003b;
+    mii[MII_PHYSID2] = 0x1881;
+    rx_ctl = 0;
+    sw_mii = 0;
+    link_up = 1;
+    tx_handler = NULL;
+
+    if ((size <= 0) || (size > AX_MODEL_FIFO_MAX))
+        size = AX_MODEL_FIFO;
+    fifo_size = size;
+    fifo_head = fifo_tail = 0L;
+}
+
+void ax88772_set_link(int up)
+{
+    link_up = up;
+}
+
+void ax88772_set_tx_handler(void (*handler)(const unsigned char *frame, long len))
+{
+    tx_handler = handler;
+}
+
+long ax88772_rx_pending(void)
+{
+    return fifo_tail - fifo_head;
+}
+
+/*
+ * queue a received frame for the driver
+ *
+ * returns -1 if the chip would drop it (receiver not started, link down,
+ * or no room in the FIFO)
+ */
+int ax88772_rx(const void *frame, long len)
+{
+    unsigned long hdr;
+    unsigned char *p;
+    long need;
+
+    if ((len < 1) || (len > ETH_MAX_LEN))
+        return -1;
+
+    need = 4 + len + (len & 1);
+    if (!(rx_ctl & AX_RX_CTL_SO) || !link_up
+     || (fifo_tail - fifo_head + need > fifo_size)) {
+        ax88772_stats.rx_overruns++;
+        return -1;
+    }
+
+    if (fifo_tail + need > AX_MODEL_FIFO_MAX) {
+        memmove(fifo, fifo + fifo_head, fifo_tail - fifo_head);
+        fifo_tail -= fifo_head;
+        fifo_head = 0L;
+    }
+
+    hdr = ((len ^ 0xffffUL) << 16) | len;
+    p = fifo + fifo_tail;
+    p[0] = hdr & 0xff;
+    p[1] = (hdr >> 8) & 0xff;
+    p[2] = (hdr >> 16) & 0xff;
+    p[3] = (hdr >> 24) & 0xff;
+    memcpy(p+4, frame, len);
+    if (len & 1)
+        p[4+len] = 0;
+    fifo_tail += need;
+
+    ax88772_stats.rx_frames++;
+    ax88772_stats.rx_bytes += len;
+
+    return 0;
+}
+
+
+static void put16(void *data, unsigned short v)
+{
+    unsigned char *p = data;
+
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static long ax_control(void *priv, int in, unsigned char request,
+                unsigned short value, unsigned short index,
+                void *data, unsigned short size)
+{
+    unsigned char *p = data;
+
+    (void)priv;
+
+    if (in) {
+        switch(request) {
+        case AX_CMD_READ_MII_REG:
+            if (!sw_mii || (value != AX_PHY_ID) || (index >= 32) || (size != 2))
+                break;
+            if (index == MII_BMSR)
+                put16(data, BMSR_ANEGCOMPLETE | (link_up ? BMSR_LSTATUS : 0));
+            else put16(data, mii[index]);
+            return size;
+        case AX_CMD_READ_EEPROM:
+            if ((value < 0x04) || (value > 0x06) || (size != 2))
+                break;
+            p[0] = node_id[(value-0x04)*2];
+            p[1] = node_id[(value-0x04)*2+1];
+            return size;
+        case AX_CMD_READ_RX_CTL:
+            if (size != 2)
+                break;
+            put16(data, rx_ctl);
+            return size;
+        case AX_CMD_READ_NODE_ID:
+            if (size != 6)
+                break;
+            memcpy(data, node_id, 6);
+            return size;
+        case AX_CMD_READ_PHY_ID:
+            if (size != 2)
+                break;
+            p[0] = 0xe0;
+            p[1] = AX_PHY_ID;
+            return size;
+        }
+    } else {
+        switch(request) {
+        case AX_CMD_SET_SW_MII:
+            sw_mii = 1;
+            return size;
+        case AX_CMD_SET_HW_MII:
+            sw_mii = 0;
+            return size;
+        case AX_CMD_WRITE_MII_REG:
+            if (!sw_mii || (value != AX_PHY_ID) || (index >= 32) || (size != 2))
+                break;
+            mii[index] = (p[0] | (p[1] << 8)) & ~(BMCR_RESET | BMCR_ANRESTART);
+            return size;
+        case AX_CMD_WRITE_RX_CTL:
+            rx_ctl = value;
+            if (!(rx_ctl & AX_RX_CTL_SO))
+                fifo_head = fifo_tail = 0L;
+            return size;
+        case AX_CMD_SW_RESET:
+            rx_ctl = 0;
+            fifo_head = fifo_tail = 0L;
+            return size;
+        case AX_CMD_WRITE_IPG0:
+        case AX_CMD_WRITE_MEDIUM_MODE:
+        case AX_CMD_WRITE_GPIOS:
+        case AX_CMD_SW_PHY_SELECT:
+            return size;
+        }
+    }
+
+    ax88772_stats.protocol_errors++;
+
+    return -1;
+}
+
+
+static long ax_bulk_in(void *priv, int ep, void *data, long len)
+{
+    long burst = 2048L << ((rx_ctl & AX_RX_CTL_MFB) >> 8);
+    long n;
+
+    (void)priv;
+
+    if (ep != EP_IN)
+        return -1;
+
+    n = fifo_tail - fifo_head;
+    if (n > len)
+        n = len;
+    if (n > burst)
+        n = burst;
+    memcpy(data, fifo + fifo_head, n);
+    fifo_head += n;
+    if (fifo_head == fifo_tail)
+        fifo_head = fifo_tail = 0L;
+
+    return n;
+}
+
+
+static long ax_bulk_out(void *priv, int ep, const void *data, long len)
+{
+    const unsigned char *p = data;
+    unsigned long hdr;
+    long off, flen, frames = 0L, bytes = 0L;
+
+    (void)priv;
+
+    if (ep != EP_OUT)
+        return -1;
+
+    ax88772_stats.tx_transfers++;
+    if ((len % 512) == 0)
+        ax88772_stats.tx_zlp++;
+
+    /* first pass: check the framing of the whole transfer */
+    for (off = 0L; off < len; off += 4 + flen + (flen & 1)) {
+        if (off + 4 > len)
+            goto bad;
+        hdr = p[off] | (p[off+1] << 8) | ((unsigned long)p[off+2] << 16)
+            | ((unsigned long)p[off+3] << 24);
+        if (hdr == AX_TX_PAD) {
+            if (off + 4 != len)
+                goto bad;
+            ax88772_stats.tx_pads++;
+            break;
+        }
+        if (((~hdr >> 16) & 0x7ff) != (hdr & 0x7ff))
+            goto bad;
+        flen = hdr & 0x7ff;
+        if ((flen < 1) || (flen > ETH_MAX_LEN) || (off + 4 + flen > len))
+            goto bad;
+        frames++;
+        bytes += flen;
+    }
+
+    ax88772_stats.tx_frames += frames;
+    ax88772_stats.tx_bytes += bytes;
+
+    if (tx_handler) {
+        for (off = 0L; frames--; off += 4 + flen + (flen & 1)) {
+            flen = p[off] | ((p[off+1] & 0x07) << 8);
+            tx_handler(p+off+4, flen);
+        }
+    }
+
+    return len;
+
+bad:
+    ax88772_stats.tx_errors++;
+
+    return len;         /* the chip discards it, but the transfer completes */
+}
+
+
+/*
+ * interrupt endpoint: an 8-byte status report, with the link state in
+ * byte 2, every time it is polled
+ */
+static long ax_int_in(void *priv, int ep, void *data, long len)
+{
+    unsigned char *p = data;
+
+    (void)priv;
+
+    if ((ep != EP_INT) || (len < 8))
+        return -1;
+
+    memset(p, 0, 8);
+    p[0] = 0xa1;
+    p[2] = link_up ? 0x01 : 0x00;
+
+    return 8;
+}
+
+
+static const struct host_endpoint ax_ep[] = {
+    { USB_DIR_IN | EP_INT, USB_ENDPOINT_XFER_INT, 8, 11 },
+    { USB_DIR_IN | EP_IN, USB_ENDPOINT_XFER_BULK, 512, 0 },
+    { EP_OUT, USB_ENDPOINT_XFER_BULK, 512, 0 }
+};
+
+struct usb_model ax88772_model = {
+    "AX88772B", 0x0b95, 0x772b, NULL, ax_ep, 3,
+    ax_control, ax_bulk_in, ax_bulk_out, ax_int_in, NULL
+};
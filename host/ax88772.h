@@ -0,0 +1,44 @@
+/*
+ * model of an AX88772B USB ethernet adapter, for the host harness
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#ifndef __AX88772_H__
+#define __AX88772_H__
+
+#include "usb_host.h"
+
+#define AX_MODEL_FIFO       16384L      /* default receive FIFO size */
+#define AX_MODEL_FIFO_MAX   131072L
+
+struct ax88772_stats {
+    unsigned long rx_frames;        /* frames queued for the driver */
+    unsigned long rx_bytes;
+    unsigned long rx_overruns;      /* frames dropped, FIFO full or receiver off */
+    unsigned long tx_transfers;     /* bulk-out transfers */
+    unsigned long tx_frames;        /* valid frames in them */
+    unsigned long tx_bytes;
+    unsigned long tx_pads;          /* zero-length padding frames */
+    unsigned long tx_errors;        /* framing errors (transfer discarded) */
+    unsigned long tx_zlp;           /* transfers that needed a zero-length packet */
+    unsigned long protocol_errors;  /* unexpected control requests */
+};
+
+extern struct ax88772_stats ax88772_stats;
+extern struct usb_model ax88772_model;
+
+void ax88772_reset(long fifo_size);
+int ax88772_rx(const void *frame, long len);
+long ax88772_rx_pending(void);
+void ax88772_set_link(int up);
+void ax88772_set_tx_handler(void (*handler)(const unsigned char *frame, long len));
+
+#endif /* __AX88772_H__ */
@@ -0,0 +1,238 @@
+/*
+ * axsim: run traffic through the ASIX back end and the AX88772B model
+ *
+ * Each traffic profile is received (frames queued in the model's FIFO in
+ * bursts, then read via asix_recv_ptr()) and transmitted (frames built
+ * in place via asix_send_buffer()/asix_send(), then sent via
+ * asix_send_flush()).  Every frame is checked at the other end.  Rates
+ * are in host time, so they are only meaningful relative to each other.
+ *
+ * usage: axsim [-n frames] [-f fifo_bytes] [profile ...]
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ax88772.h"
+#include "asix.h"
+#include "traffic.h"
+
+extern unsigned long memcpy_bytes;
+
+static struct ueth_data ss;
+static unsigned long tx_expect, tx_bad;
+
+/*
+ * check each frame the model receives from the driver
+ */
+static void tx_check(const unsigned char *frame, long len)
+{
+    if (traffic_check(frame, len, tx_expect++) != 0)
+        tx_bad++;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const struct traffic_profile *prof, const char *dir,
+                unsigned long frames, unsigned long bytes, double secs,
+                unsigned long copied, unsigned long transfers,
+                unsigned long wrapped, unsigned long errors)
+{
+    double n = frames ? (double)frames : 1.0;
+
+    if (secs <= 0.0)
+        secs = 1e-9;
+
+    printf("%-7s %-2s %8lu %10.0f %8.2f %10.1f %7.3f %7lu %6lu\n",
+            prof->name, dir, frames, frames / secs, bytes / secs / 1e6,
+            copied / n, transfers / n, wrapped, errors);
+}
+
+static void run_rx(const struct traffic_profile *prof, unsigned long total)
+{
+    static unsigned char wrap_buf[2048] __attribute__ ((aligned(4)));
+    unsigned char frame[1514], *pkt;
+    unsigned long queued = 0UL, received = 0UL, bytes = 0UL, errors = 0UL;
+    unsigned long copied, transfers, wrapped;
+    double start, secs = 0.0;
+    long rc, len;
+    int i;
+
+    copied = memcpy_bytes;
+    transfers = host_usb_stats.bulk_in + host_usb_stats.bulk_in_empty;
+    wrapped = ss.rx_wrapped;
+
+    while (received < total) {
+        for (i = 0; (i < prof->burst) && (queued < total); i++, queued++) {
+            len = traffic_frame(prof, frame, queued);
+            if (ax88772_rx(frame, len) < 0)
+                break;
+        }
+
+        start = now();
+        while ((rc = asix_recv_ptr(&ss, &pkt, wrap_buf, sizeof(wrap_buf))) != 0) {
+            if ((rc < 0) || (traffic_check(pkt, rc, received) != 0))
+                errors++;
+            if (rc > 0)
+                bytes += rc;
+            received++;
+        }
+        secs += now() - start;
+
+        if (i == 0)
+            break;          /* the model would not accept anything */
+    }
+
+    report(prof, "rx", received, bytes, secs, memcpy_bytes - copied,
+            host_usb_stats.bulk_in + host_usb_stats.bulk_in_empty - transfers,
+            ss.rx_wrapped - wrapped, errors);
+}
+
+static void run_tx(const struct traffic_profile *prof, unsigned long total)
+{
+    unsigned long sent = 0UL, bytes = 0UL, errors = 0UL;
+    unsigned long copied, transfers, stats_errors, zlp;
+    unsigned char *p;
+    double start;
+    long len;
+    int i;
+
+    tx_expect = 0UL;
+    tx_bad = 0UL;
+    copied = memcpy_bytes;
+    transfers = host_usb_stats.bulk_out;
+    stats_errors = ax88772_stats.tx_errors;
+    zlp = ax88772_stats.tx_zlp;
+
+    start = now();
+    while (sent < total) {
+        for (i = 0; (i < prof->burst) && (sent < total); i++, sent++) {
+            p = asix_send_buffer(&ss);
+            if (!p) {
+                if (asix_send_flush(&ss) < 0)
+                    errors++;
+                p = asix_send_buffer(&ss);
+            }
+            len = traffic_frame(prof, p, sent);
+            if (asix_send(&ss, p, len) < 0)
+                errors++;
+            bytes += len;
+        }
+        if (asix_send_flush(&ss) < 0)
+            errors++;
+    }
+
+    report(prof, "tx", sent, bytes, now() - start, memcpy_bytes - copied,
+            host_usb_stats.bulk_out - transfers, 0UL,
+            errors + tx_bad + (tx_expect != sent) + ax88772_stats.tx_errors - stats_errors
+            + ax88772_stats.tx_zlp - zlp);
+}
+
+static void run_idle(const struct traffic_profile *prof, unsigned long total)
+{
+    static unsigned char wrap_buf[2048] __attribute__ ((aligned(4)));
+    unsigned char *pkt;
+    unsigned long n, errors = 0UL, transfers;
+    double start;
+
+    transfers = host_usb_stats.bulk_in + host_usb_stats.bulk_in_empty;
+
+    start = now();
+    for (n = 0UL; n < total; n++)
+        if (asix_recv_ptr(&ss, &pkt, wrap_buf, sizeof(wrap_buf)) != 0)
+            errors++;
+
+    /* report polls rather than frames */
+    report(prof, "rx", n, 0UL, now() - start, 0UL,
+            host_usb_stats.bulk_in + host_usb_stats.bulk_in_empty - transfers,
+            0UL, errors);
+}
+
+static void usage(void)
+{
+    const struct traffic_profile *prof;
+
+    fprintf(stderr, "usage: axsim [-n frames] [-f fifo_bytes] [profile ...]\nprofiles:");
+    for (prof = traffic_profiles; prof->name; prof++)
+        fprintf(stderr, " %s", prof->name);
+    fprintf(stderr, "\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const struct traffic_profile *prof;
+    struct usb_device *dev;
+    unsigned char mac[6];
+    unsigned long total = 100000UL;
+    long fifo = 0L;
+    int i, first;
+
+    for (i = 1; (i < argc) && (argv[i][0] == '-'); i++) {
+        if ((strcmp(argv[i], "-n") == 0) && (i+1 < argc))
+            total = strtoul(argv[++i], NULL, 0);
+        else if ((strcmp(argv[i], "-f") == 0) && (i+1 < argc))
+            fifo = strtol(argv[++i], NULL, 0);
+        else usage();
+    }
+    first = i;
+    for ( ; i < argc; i++) {
+        for (prof = traffic_profiles; prof->name; prof++)
+            if (strcmp(argv[i], prof->name) == 0)
+                break;
+        if (!prof->name)
+            usage();
+    }
+
+    ax88772_reset(fifo);
+    ax88772_set_tx_handler(tx_check);
+    dev = host_usb_attach(&ax88772_model);
+    asix_eth_before_probe(host_usb_api());
+    if (!asix_eth_probe(dev, 0, &ss) || !asix_eth_get_info(dev, &ss, mac)) {
+        fprintf(stderr, "axsim: probe failed\n");
+        return 1;
+    }
+    ss.tx_batch = 8192L;
+
+    printf("%-7s %-2s %8s %10s %8s %10s %7s %7s %6s\n", "profile", "", "frames",
+            "pkts/s", "MB/s", "copied/pkt", "usb/pkt", "wrapped", "errors");
+    for (prof = traffic_profiles; prof->name; prof++) {
+        if (first < argc) {
+            for (i = first; i < argc; i++)
+                if (strcmp(argv[i], prof->name) == 0)
+                    break;
+            if (i == argc)
+                continue;
+        }
+        if (prof->num_sizes == 0) {
+            run_idle(prof, total);
+            continue;
+        }
+        run_rx(prof, total);
+        run_tx(prof, total);
+    }
+
+    if (ax88772_stats.protocol_errors)
+        printf("control requests rejected by the model: %lu\n", ax88772_stats.protocol_errors);
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * bench: sweep frame sizes & burst lengths through the whole port driver
+ *
+ * The driver is loaded with one of the adapter models attached (see
+ * drive.c).  For each frame size and burst length, frames are received
+ * through receive_dgrams() and sent through send_dgrams(), and the rates
+ * and per-packet costs are written as CSV, one row per path, size and
+ * burst, tagged with the driver's version & date so that the results of
+ * different releases can be compared.  Frames that do not fit in the
+ * adapter's receive FIFO are counted as dropped.
+ *
+ * Rates are in host time, so they are only meaningful relative to each
+ * other (e.g. between releases, on the same machine); the per-packet
+ * costs do not depend on the host.
+ *
+ * usage: bench [-n frames] [-H] [asix|picowifi]
+ *      -n  frames per size & burst (default 10000)
+ *      -H  omit the CSV header
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "drive.h"
+
+static const short sizes[] = { 60, 128, 256, 512, 1024, 1514 };
+static const int bursts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+#define NUM_SIZES   (sizeof(sizes)/sizeof(sizes[0]))
+#define NUM_BURSTS  (sizeof(bursts)/sizeof(bursts[0]))
+
+
+static void csv_row(PORT *port, const struct adapter *ad, const char *path,
+                int size, int burst, const struct drive_result *r)
+{
+    uint16 date = port->driver->date;   /* GEMDOS format */
+    double n = r->frames ? (double)r->frames : 1.0;
+    double secs = (r->secs > 0.0) ? r->secs : 1e-9;
+
+    printf("%s,%04d-%02d-%02d,%s,%s,%d,%d,%lu,%lu,%lu,%lu,%.0f,%.0f,%.1f,%.3f,%.3f,%.3f\n",
+            port->driver->version, ((date>>9)&0x7f)+1980, (date>>5)&0x0f, date&0x1f,
+            ad->name, path, size, burst, r->frames, r->dropped, r->lost, r->bad,
+            r->frames / secs, r->bytes / secs, r->copied / n, r->allocs / n,
+            r->frees / n, r->usb / n);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: bench [-n frames] [-H] [asix|picowifi]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const struct adapter *ad = adapters;
+    struct drive_result r;
+    unsigned long total = 10000UL;
+    int header = 1, failed = 0;
+    PORT *port;
+    int i, j;
+
+    for (i = 1; (i < argc) && (argv[i][0] == '-'); i++) {
+        if ((strcmp(argv[i], "-n") == 0) && (i+1 < argc))
+            total = strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-H") == 0)
+            header = 0;
+        else usage();
+    }
+    if ((i < argc) && (!(ad=drive_adapter(argv[i])) || (i+1 < argc)))
+        usage();
+
+    if (!(port=drive_load(ad)))
+        return 1;
+
+    if (header)
+        printf("version,date,adapter,path,frame_size,burst,packets,dropped,lost,bad,"
+                "pkts_per_sec,bytes_per_sec,copied_per_pkt,krmalloc_per_pkt,"
+                "krfree_per_pkt,usb_per_pkt\n");
+
+    for (i = 0; i < NUM_SIZES; i++) {
+        for (j = 0; j < NUM_BURSTS; j++) {
+            drive_rx(ad, port, &sizes[i], 1, bursts[j], total, &r);
+            csv_row(port, ad, "receive_dgrams", sizes[i], bursts[j], &r);
+            if (r.lost || r.bad)
+                failed = 1;
+            drive_tx(port, &sizes[i], 1, bursts[j], total, &r);
+            csv_row(port, ad, "send_dgrams", sizes[i], bursts[j], &r);
+            if (r.lost || r.bad)
+                failed = 1;
+        }
+    }
+
+    if (sting_stats.blocks) {
+        fprintf(stderr, "bench: %ld blocks not returned to STinG\n", sting_stats.blocks);
+        failed = 1;
+    }
+
+    return failed;
+}
@@ -0,0 +1,236 @@
+/*
+ * drive the whole port driver as STinG would, for the host harness
+ *
+ * The driver is loaded by the STinG stand-in (see sting.c) with one of
+ * the adapter models attached, and brought up with the peer (see peer.c)
+ * as its default gateway.  The tests then do the work of STinG's IP
+ * layer: dgrams received by the driver are taken from the port's receive
+ * queue and checked, and dgrams to send are put on its send queue, to be
+ * checked by the peer when they reach the model.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "drive.h"
+#include "peer.h"
+#include "ax88772.h"
+#include "pico.h"
+
+extern unsigned long memcpy_bytes;
+
+static void asix_reset(void)
+{
+    ax88772_reset(0L);
+}
+
+static void picowifi_reset(void)
+{
+    pico_reset(NULL, 1UL);
+}
+
+const struct adapter adapters[] = {
+    { "asix", &ax88772_model, asix_reset, ax88772_rx, ax88772_rx_pending, ax88772_set_tx_handler },
+    { "picowifi", &pico_model, picowifi_reset, pico_rx, pico_rx_pending, pico_set_tx_handler },
+    { NULL }
+};
+
+static struct drive_result *result;
+static unsigned long rx_expect;
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long usb_transfers(void)
+{
+    return host_usb_stats.bulk_in + host_usb_stats.bulk_in_empty + host_usb_stats.bulk_out;
+}
+
+/*
+ * call receive_dgrams() or send_dgrams(), adding up what it costs
+ */
+static void driver_call(void cdecl (*func)(PORT *port), PORT *port)
+{
+    unsigned long copied = memcpy_bytes, allocs = sting_stats.allocs;
+    unsigned long frees = sting_stats.frees, usb = usb_transfers();
+    double start = now();
+
+    (*func)(port);
+
+    result->secs += now() - start;
+    result->copied += memcpy_bytes - copied;
+    result->allocs += sting_stats.allocs - allocs;
+    result->frees += sting_stats.frees - frees;
+    result->usb += usb_transfers() - usb;
+}
+
+const struct adapter *drive_adapter(const char *name)
+{
+    const struct adapter *ad;
+
+    for (ad = adapters; ad->name; ad++)
+        if (strcmp(name, ad->name) == 0)
+            return ad;
+
+    return NULL;
+}
+
+/*
+ * load the driver with an adapter attached, and bring its port up
+ *
+ * the driver announces itself and resolves the gateway on its first
+ * timer call; the peer also asks for the driver's address
+ *
+ * returns the port, or NULL if any of this fails
+ */
+PORT *drive_load(const struct adapter *ad)
+{
+    unsigned char mac[ETH_ALEN], frame[ETH_MAX_LEN];
+    PORT *port;
+
+    ad->reset();
+    host_usb_attach(ad->model);
+    if (!(port=sting_load())) {
+        fprintf(stderr, "driver did not install\n");
+        return NULL;
+    }
+
+    memset(mac, 0, sizeof(mac));
+    (*port->driver->cntrl)(port, (uaddr)mac, CTL_ETHER_GET_MAC);
+    if (memcmp(mac, "\0\0\0\0\0\0", ETH_ALEN) == 0) {
+        fprintf(stderr, "driver found no adapter\n");
+        return NULL;
+    }
+    peer_init(mac, ad->rx);
+    ad->set_tx_handler(peer_tx);
+
+    sting_add_route(0UL, 0UL, port, PEER_IP);
+    if (sting_port_up(port, LOCAL_IP, NETMASK) < 0) {
+        fprintf(stderr, "cannot activate port\n");
+        return NULL;
+    }
+    sting_timer();
+    ad->rx(frame, peer_arp_request(frame));
+    do {
+        (*port->driver->receive)(port);
+    } while (ad->rx_pending());
+    (*port->driver->receive)(port);
+
+    return port;
+}
+
+/*
+ * check each dgram that the driver receives
+ */
+static void rx_check(IP_DGRAM *dgram)
+{
+    unsigned long seq = peer_seq(dgram->pkt_data, dgram->pkt_length);
+
+    if ((dgram->hdr.ip_src != PEER_IP) || (seq < rx_expect)
+     || (peer_check(dgram->pkt_data, dgram->pkt_length, seq) != 0)) {
+        result->bad++;
+        return;
+    }
+    result->lost += seq - rx_expect;
+    rx_expect = seq + 1;
+    result->frames++;
+    result->bytes += PEER_HDR_LEN + dgram->pkt_length;
+}
+
+/*
+ * receive: frames are queued in the model a burst at a time, then
+ * receive_dgrams() is called until it has taken them all.  frames that
+ * do not fit in the adapter's FIFO are dropped, as they would be by the
+ * real adapter.
+ */
+void drive_rx(const struct adapter *ad, PORT *port, const short *sizes, int num_sizes,
+                int burst, unsigned long total, struct drive_result *r)
+{
+    unsigned char frame[ETH_MAX_LEN];
+    unsigned long queued = 0UL;
+    long n;
+    int i;
+
+    memset(r, 0, sizeof(*r));
+    result = r;
+    rx_expect = 0UL;
+    sting_stats.receive_max = 0L;
+
+    while (queued < total) {
+        for (i = 0; (i < burst) && (queued < total); i++, queued++)
+            if (ad->rx(frame, peer_ip_frame(frame, sizes[queued % num_sizes], queued)) < 0)
+                r->dropped++;
+
+        do {
+            driver_call(port->driver->receive, port);
+            n = sting_deliver(port, rx_check);
+        } while (n || ad->rx_pending());
+        sting_timer();
+    }
+    r->lost += queued - rx_expect;
+    r->lost -= r->dropped;
+    r->queue_max = sting_stats.receive_max;
+}
+
+/*
+ * send: dgrams are queued a burst at a time, then send_dgrams() is called
+ * (receive_dgrams() is also called, uncounted, for any ARP replies)
+ */
+void drive_tx(PORT *port, const short *sizes, int num_sizes,
+                int burst, unsigned long total, struct drive_result *r)
+{
+    unsigned char data[ETH_MAX_LEN];
+    IP_DGRAM *dgram;
+    unsigned long sent = 0UL, frames, bytes, bad;
+    long len;
+    int i;
+
+    memset(r, 0, sizeof(*r));
+    result = r;
+    frames = peer_stats.ip_frames;
+    bytes = peer_stats.ip_bytes;
+    bad = peer_stats.ip_bad;
+    sting_stats.send_max = 0L;
+    peer_tx_reset();
+
+    while (sent < total) {
+        for (i = 0; (i < burst) && (sent < total); i++, sent++) {
+            len = sizes[sent % num_sizes] - PEER_HDR_LEN;
+            peer_payload(data, len, sent);
+            if (!(dgram=sting_dgram(LOCAL_IP, PEER_IP, data, len))) {
+                r->bad++;
+                continue;
+            }
+            sting_send(port, dgram);
+        }
+        driver_call(port->driver->send, port);
+
+        (*port->driver->receive)(port);
+        sting_deliver(port, NULL);
+        sting_timer();
+    }
+
+    r->frames = peer_stats.ip_frames - frames;
+    r->bytes = peer_stats.ip_bytes - bytes + r->frames * PEER_HDR_LEN;
+    r->lost = sent - r->frames;
+    r->bad += peer_stats.ip_bad - bad;
+    r->queue_max = sting_stats.send_max;
+}
@@ -0,0 +1,59 @@
+/*
+ * drive the whole port driver as STinG would, for the host harness
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#ifndef __DRIVE_H__
+#define __DRIVE_H__
+
+#include "sting.h"
+#include "usb_host.h"
+
+/*
+ * an adapter model that can be attached
+ */
+struct adapter {
+    const char *name;
+    struct usb_model *model;
+    void (*reset)(void);
+    int (*rx)(const void *frame, long len);
+    long (*rx_pending)(void);
+    void (*set_tx_handler)(void (*handler)(const unsigned char *frame, long len));
+};
+
+/*
+ * the result of a test: costs are counted over the driver's
+ * receive_dgrams() or send_dgrams() calls only
+ */
+struct drive_result {
+    unsigned long frames;           /* frames that arrived intact */
+    unsigned long bytes;            /*  their length */
+    unsigned long lost;
+    unsigned long bad;              /* damaged or out of order */
+    unsigned long dropped;          /* refused by the adapter (receive FIFO full) */
+    long queue_max;                 /* deepest STinG queue */
+    double secs;
+    unsigned long copied;           /* bytes copied by memcpy() */
+    unsigned long allocs;           /* KRmalloc() calls */
+    unsigned long frees;            /* KRfree() calls */
+    unsigned long usb;              /* bulk transfers */
+};
+
+extern const struct adapter adapters[];
+
+const struct adapter *drive_adapter(const char *name);
+PORT *drive_load(const struct adapter *ad);
+void drive_rx(const struct adapter *ad, PORT *port, const short *sizes, int num_sizes,
+                int burst, unsigned long total, struct drive_result *r);
+void drive_tx(PORT *port, const short *sizes, int num_sizes,
+                int burst, unsigned long total, struct drive_result *r);
+
+#endif /* __DRIVE_H__ */
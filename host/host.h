@@ -0,0 +1,20 @@
+/*
+ * included ahead of each driver source file in the host build (see Makefile)
+ */
+#ifndef __HOST_H__
+#define __HOST_H__
+
+#include <string.h>
+
+unsigned long host_clock(void);
+void *host_memcpy(void *dest, const void *src, unsigned long n);
+extern void *host_p_cookie;
+
+#define hz_200      host_clock()            /* see usb_host.c */
+#define _p_cookie   ((long)&host_p_cookie)  /* see sting.c */
+#define _init       driver_init             /* _init() is taken by the C runtime */
+
+/* count the bytes the driver copies, as utility.c does on the Atari */
+#define memcpy(d, s, n) host_memcpy((d), (s), (n))
+
+#endif /* __HOST_H__ */
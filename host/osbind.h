@@ -0,0 +1,23 @@
+/*
+ * host stand-in for the TOS bindings used by the driver
+ */
+#ifndef __OSBIND_H__
+#define __OSBIND_H__
+
+#define Supexec(f)  host_supexec((long (*)(void))(f))
+
+long host_supexec(long (*func)(void));
+long Bconout(int dev, int c);
+long Cconws(const char *str);
+long Drvmap(void);
+long Fopen(const char *name, int mode);
+long Fread(long handle, long count, void *buf);
+long Fclose(long handle);
+long Malloc(long size);
+long Mxalloc(long size, int mode);
+void Pterm(int code);
+void Ptermres(long size, int code);
+long Super(void *stack);
+void SuperToUser(void *stack);
+
+#endif /* __OSBIND_H__ */
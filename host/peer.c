@@ -0,0 +1,229 @@
+/*
+ * the remote host on the simulated LAN, for the host harness
+ *
+ * The peer builds the frames that the driver receives, and takes the
+ * frames that the driver sends (via the adapter model's transmit
+ * handler): IP frames are checked, and ARP requests for the peer's
+ * address are answered at once, by queueing the reply in the model.
+ *
+ * Frames are built and parsed with the driver's own structures, so they
+ * are in host byte order; the adapter models never look inside them.
+ *
+ * Every IP payload starts with a 4-byte sequence number, followed by a
+ * pattern derived from it, so that damage, loss and reordering can be
+ * detected.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#include <string.h>
+
+#include "peer.h"
+
+#define ARP_FRAME_LEN   60L         /* ARP packet, padded to the minimum frame size */
+
+struct peer_stats peer_stats;
+
+static const unsigned char peer_mac[ETH_ALEN] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+static unsigned char local_mac[ETH_ALEN];
+static int (*model_rx)(const void *frame, long len);
+static unsigned long tx_expect;
+
+
+/*
+ * mac is the driver's address; rx() queues a frame for the driver
+ */
+void peer_init(const unsigned char *mac, int (*rx)(const void *frame, long len))
+{
+    memset(&peer_stats, 0, sizeof(peer_stats));
+    memcpy(local_mac, mac, ETH_ALEN);
+    model_rx = rx;
+    tx_expect = 0UL;
+}
+
+/*
+ * restart the sequence of IP frames expected from the driver
+ */
+void peer_tx_reset(void)
+{
+    tx_expect = 0UL;
+}
+
+void peer_payload(void *data, long len, unsigned long seq)
+{
+    unsigned char *p = data;
+    long i;
+
+    for (i = 0L; i < len; i++)
+        p[i] = seq + i;
+    if (len >= 4L) {
+        p[0] = seq >> 24;
+        p[1] = seq >> 16;
+        p[2] = seq >> 8;
+        p[3] = seq;
+    }
+}
+
+unsigned long peer_seq(const void *data, long len)
+{
+    const unsigned char *p = data;
+
+    if (len < 4L)
+        return 0UL;
+
+    return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/*
+ * check that a payload is that of 'seq', intact: returns 0 if so
+ */
+int peer_check(const void *data, long len, unsigned long seq)
+{
+    const unsigned char *p = data;
+    long i;
+
+    if ((len < 4L) || (peer_seq(data, len) != seq))
+        return -1;
+    for (i = 4L; i < len; i++)
+        if (p[i] != (unsigned char)(seq + i))
+            return -1;
+
+    return 0;
+}
+
+/*
+ * build IP frame 'seq' for the driver, len bytes long in all
+ */
+long peer_ip_frame(unsigned char *frame, long len, unsigned long seq)
+{
+    ENET_HDR eh;
+    IP_HDR ip;
+
+    if (len < PEER_HDR_LEN + 4)
+        len = PEER_HDR_LEN + 4;
+    if (len > ETH_MAX_LEN)
+        len = ETH_MAX_LEN;
+
+    memcpy(eh.destination, local_mac, ETH_ALEN);
+    memcpy(eh.source, peer_mac, ETH_ALEN);
+    eh.type = ENET_TYPE_IP;
+
+    memset(&ip, 0, sizeof(ip));
+    ip.version = 4;
+    ip.hd_len = sizeof(IP_HDR) / 4;
+    ip.length = len - ETH_HLEN;
+    ip.ttl = 64;
+    ip.protocol = P_UDP;
+    ip.ip_src = PEER_IP;
+    ip.ip_dest = LOCAL_IP;
+
+    memcpy(frame, &eh, ETH_HLEN);
+    memcpy(frame+ETH_HLEN, &ip, sizeof(ip));
+    peer_payload(frame+PEER_HDR_LEN, len-PEER_HDR_LEN, seq);
+
+    return len;
+}
+
+static long arp_frame(unsigned char *frame, const char *dest, uint16 op,
+                const char *dest_ether, uint32 dest_ip)
+{
+    ARP_PACKET pkt;
+
+    memset(&pkt, 0, sizeof(pkt));
+    memcpy(pkt.eh.destination, dest, ETH_ALEN);
+    memcpy(pkt.eh.source, peer_mac, ETH_ALEN);
+    pkt.eh.type = ENET_TYPE_ARP;
+    pkt.arp.hardware_space = ARP_HARD_ETHER;
+    pkt.arp.protocol_space = ENET_TYPE_IP;
+    pkt.arp.hardware_len = ETH_ALEN;
+    pkt.arp.protocol_len = 4;
+    pkt.arp.op_code = op;
+    memcpy(pkt.arp.src_ether, peer_mac, ETH_ALEN);
+    pkt.arp.src_ip = PEER_IP;
+    memcpy(pkt.arp.dest_ether, dest_ether, ETH_ALEN);
+    pkt.arp.dest_ip = dest_ip;
+
+    memset(frame, 0, ARP_FRAME_LEN);
+    memcpy(frame, &pkt, sizeof(pkt));
+
+    return ARP_FRAME_LEN;
+}
+
+/*
+ * build an ARP request for the driver's address (from which the driver
+ * also learns ours)
+ */
+long peer_arp_request(unsigned char *frame)
+{
+    static const char zero[ETH_ALEN];
+
+    return arp_frame(frame, "\xff\xff\xff\xff\xff\xff", ARP_OP_REQ, zero, LOCAL_IP);
+}
+
+/*
+ * transmit handler for the adapter model: takes each frame the driver sends
+ */
+void peer_tx(const unsigned char *frame, long len)
+{
+    unsigned char reply[ARP_FRAME_LEN];
+    ENET_HDR eh;
+    IP_HDR ip;
+    ARP arp;
+    long hlen, plen;
+    unsigned long seq;
+
+    if (len < ETH_HLEN) {
+        peer_stats.other++;
+        return;
+    }
+    memcpy(&eh, frame, ETH_HLEN);
+
+    switch(eh.type) {
+    case ENET_TYPE_IP:
+        if (len < PEER_HDR_LEN)
+            break;
+        memcpy(&ip, frame+ETH_HLEN, sizeof(ip));
+        hlen = ip.hd_len * 4;
+        plen = ip.length - hlen;
+        if ((memcmp(eh.destination, peer_mac, ETH_ALEN) != 0)
+         || (ip.ip_dest != PEER_IP) || (hlen < sizeof(IP_HDR))
+         || (ETH_HLEN + hlen + plen > len))
+            break;
+        seq = peer_seq(frame+ETH_HLEN+hlen, plen);
+        if ((seq < tx_expect) || (peer_check(frame+ETH_HLEN+hlen, plen, seq) != 0))
+            break;
+        peer_stats.ip_lost += seq - tx_expect;
+        tx_expect = seq + 1;
+        peer_stats.ip_frames++;
+        peer_stats.ip_bytes += plen;
+        return;
+    case ENET_TYPE_ARP:
+        if (len < ETH_HLEN + sizeof(ARP)) {
+            peer_stats.other++;
+            return;
+        }
+        memcpy(&arp, frame+ETH_HLEN, sizeof(arp));
+        if ((arp.op_code == ARP_OP_REQ) && (arp.dest_ip == PEER_IP)) {
+            peer_stats.arp_requests++;
+            if (model_rx)
+                model_rx(reply, arp_frame(reply, arp.src_ether, ARP_OP_ANS,
+                                        arp.src_ether, arp.src_ip));
+        } else if ((arp.op_code == ARP_OP_ANS) && (arp.dest_ip == PEER_IP))
+            peer_stats.arp_replies++;
+        else peer_stats.arp_other++;
+        return;
+    default:
+        peer_stats.other++;
+        return;
+    }
+
+    peer_stats.ip_bad++;
+}
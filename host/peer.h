@@ -0,0 +1,47 @@
+/*
+ * the remote host on the simulated LAN, for the host harness
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#ifndef __PEER_H__
+#define __PEER_H__
+
+#include "usbsting.h"
+
+#define PEER_IP         0xc0a80101UL    /* 192.168.1.1 */
+#define LOCAL_IP        0xc0a80102UL    /* 192.168.1.2: the driver's port */
+#define NETMASK         0xffffff00UL
+
+#define PEER_HDR_LEN    (ETH_HLEN + sizeof(IP_HDR))    /* frame bytes before the payload */
+
+struct peer_stats {
+    unsigned long ip_frames;        /* intact IP frames from the driver */
+    unsigned long ip_bytes;         /*  their payload bytes */
+    unsigned long ip_lost;          /* gaps in their sequence */
+    unsigned long ip_bad;           /* damaged, misaddressed or out of order */
+    unsigned long arp_requests;     /* ARP requests for our address (answered) */
+    unsigned long arp_replies;      /* ARP replies from the driver */
+    unsigned long arp_other;        /* e.g. gratuitous ARP */
+    unsigned long other;            /* frames of any other type */
+};
+
+extern struct peer_stats peer_stats;
+
+void peer_init(const unsigned char *mac, int (*rx)(const void *frame, long len));
+void peer_tx_reset(void);
+long peer_ip_frame(unsigned char *frame, long len, unsigned long seq);
+long peer_arp_request(unsigned char *frame);
+void peer_payload(void *data, long len, unsigned long seq);
+unsigned long peer_seq(const void *data, long len);
+int peer_check(const void *data, long len, unsigned long seq);
+void peer_tx(const unsigned char *frame, long len);
+
+#endif /* __PEER_H__ */
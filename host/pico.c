@@ -0,0 +1,285 @@
+/*
+ * model of a PicoWifi adapter, for the host harness
+ *
+ * Received frames are queued as the adapter's bulk-in stream of records:
+ * a 4-byte magic number and a 4-byte length (both little-endian), then
+ * the frame, without padding.  A bulk-in transfer returns as much of the
+ * stream as fits, up to the size of the device FIFO, so records are split
+ * across transfers wherever the FIFO boundary falls.
+ *
+ * A scenario (see pico_scenarios[]) can make the model misbehave:
+ * . split: each bulk-in transfer returns a random number of bytes, so
+ *   records are split at arbitrary points
+ * . corrupt: some records are preceded by garbage, or have a damaged
+ *   header, which the driver must resynchronise past
+ * . stall: bulk-in transfers sometimes find nothing for a while even
+ *   though data is queued, and some bulk-out transfers fail
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "pico.h"
+
+#define VENDOR_REQUEST_WIFI 2
+#define WIFI_SET_SSID       0
+#define WIFI_SET_PASSWD     1
+#define WIFI_CONNECT        2
+#define WIFI_STATUS         3
+
+#define MAGIC               0xAA55AA55UL
+#define REC_HDR_LEN         8
+#define ETH_MAX_LEN         1514
+
+#define EP_IN               1
+#define EP_OUT              2
+
+const struct pico_scenario pico_scenarios[] = {
+    { "clean", 0, 0, 0, 0, 0 },
+    { "split", 1, 0, 0, 0, 0 },
+    { "corrupt", 0, 10, 0, 0, 0 },
+    { "stall", 0, 0, 50, 8, 10 },
+    { NULL }
+};
+
+struct pico_stats pico_stats;
+
+static const struct pico_scenario *scenario;
+static unsigned long seed;
+static int link_up;
+static int nak_left;
+static void (*tx_handler)(const unsigned char *frame, long len);
+
+static unsigned char queue[PICO_QUEUE];
+static long queue_head, queue_tail;     /* next byte to send, next free byte */
+
+
+static unsigned long pico_random(void)
+{
+    seed = seed * 1103515245UL + 12345UL;
+
+    return (seed >> 16) & 0x7fff;
+}
+
+void pico_reset(const struct pico_scenario *s, unsigned long rand_seed)
+{
+    memset(&pico_stats, 0, sizeof(pico_stats));
+    scenario = s ? s : &pico_scenarios[0];
+    seed = rand_seed;
+    link_up = 1;
+    nak_left = 0;
+    tx_handler = NULL;
+    queue_head = queue_tail = 0L;
+}
+
+void pico_set_link(int up)
+{
+    link_up = up;
+}
+
+void pico_set_tx_handler(void (*handler)(const unsigned char *frame, long len))
+{
+    tx_handler = handler;
+}
+
+long pico_rx_pending(void)
+{
+    return queue_tail - queue_head;
+}
+
+static void put32(unsigned char *p, unsigned long v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+static unsigned long get32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+/*
+ * queue a received frame for the driver
+ *
+ * returns -1 if the adapter would drop it (link down, or no room)
+ */
+int pico_rx(const void *frame, long len)
+{
+    unsigned char *p;
+    long garbage = 0L, need;
+    int damage = -1;
+
+    if ((len < 1) || (len > ETH_MAX_LEN))
+        return -1;
+
+    if (scenario->corrupt_rate && ((long)pico_random() % 1000 < scenario->corrupt_rate)) {
+        damage = pico_random() % 3;
+        if (damage == 0)
+            garbage = 1 + pico_random() % 7;
+    }
+
+    need = garbage + REC_HDR_LEN + len;
+    if (!link_up || (queue_tail - queue_head + need > PICO_QUEUE)) {
+        pico_stats.rx_overruns++;
+        return -1;
+    }
+
+    if (queue_tail + need > PICO_QUEUE) {
+        memmove(queue, queue + queue_head, queue_tail - queue_head);
+        queue_tail -= queue_head;
+        queue_head = 0L;
+    }
+
+    p = queue + queue_tail;
+    while (garbage--)
+        *p++ = pico_random();
+    put32(p, MAGIC);
+    put32(p+4, len);
+    if (damage == 1)
+        p[0] ^= 0x01;           /* bad magic number */
+    else if (damage == 2)
+        p[5] |= 0x80;           /* impossible length */
+    memcpy(p+REC_HDR_LEN, frame, len);
+    queue_tail += need;
+
+    if (damage >= 0)
+        pico_stats.rx_corrupted++;
+    pico_stats.rx_frames++;
+    pico_stats.rx_bytes += len;
+
+    return 0;
+}
+
+
+static long pico_control(void *priv, int in, unsigned char request,
+                unsigned short value, unsigned short index,
+                void *data, unsigned short size)
+{
+    (void)priv;
+    (void)value;
+
+    if (request == VENDOR_REQUEST_WIFI) {
+        if (in && (index == WIFI_STATUS) && (size == 1)) {
+            *(unsigned char *)data = link_up ? 1 : 0;
+            return size;
+        }
+        if (!in && ((index == WIFI_SET_SSID) || (index == WIFI_SET_PASSWD)
+                 || (index == WIFI_CONNECT)))
+            return size;
+    }
+
+    pico_stats.protocol_errors++;
+
+    return -1;
+}
+
+
+static long pico_bulk_in(void *priv, int ep, void *data, long len)
+{
+    long n;
+
+    (void)priv;
+
+    if (ep != EP_IN)
+        return -1;
+
+    n = queue_tail - queue_head;
+    if (n == 0)
+        return 0;
+
+    if (nak_left > 0) {
+        nak_left--;
+        pico_stats.rx_naks++;
+        return 0;
+    }
+    if (scenario->nak_rate && ((long)pico_random() % 1000 < scenario->nak_rate)) {
+        nak_left = pico_random() % scenario->nak_max;
+        pico_stats.rx_naks++;
+        return 0;
+    }
+
+    if (n > len)
+        n = len;
+    if (n > PICO_FIFO)
+        n = PICO_FIFO;
+    if (scenario->split)
+        n = 1 + pico_random() % n;
+
+    memcpy(data, queue + queue_head, n);
+    queue_head += n;
+    if (queue_head == queue_tail)
+        queue_head = queue_tail = 0L;
+
+    return n;
+}
+
+
+static long pico_bulk_out(void *priv, int ep, const void *data, long len)
+{
+    const unsigned char *p = data;
+    long off, flen = 0L, frames = 0L, bytes = 0L;
+
+    (void)priv;
+
+    if (ep != EP_OUT)
+        return -1;
+
+    if (scenario->tx_stall_rate && ((long)pico_random() % 1000 < scenario->tx_stall_rate)) {
+        pico_stats.tx_stalls++;
+        return -1;
+    }
+
+    pico_stats.tx_transfers++;
+    if (len > PICO_FIFO)
+        goto bad;
+
+    /* first pass: check the framing of the whole transfer */
+    for (off = 0L; off < len; off += REC_HDR_LEN + flen) {
+        if ((off + REC_HDR_LEN > len) || (get32(p+off) != MAGIC))
+            goto bad;
+        flen = get32(p+off+4);
+        if ((flen < 1) || (flen > ETH_MAX_LEN) || (off + REC_HDR_LEN + flen > len))
+            goto bad;
+        frames++;
+        bytes += flen;
+    }
+
+    pico_stats.tx_frames += frames;
+    pico_stats.tx_bytes += bytes;
+
+    if (tx_handler) {
+        for (off = 0L; off < len; off += REC_HDR_LEN + flen) {
+            flen = get32(p+off+4);
+            tx_handler(p+off+REC_HDR_LEN, flen);
+        }
+    }
+
+    return len;
+
+bad:
+    pico_stats.tx_errors++;
+
+    return len;         /* the adapter discards it, but the transfer completes */
+}
+
+
+static const struct host_endpoint pico_ep[] = {
+    { USB_DIR_IN | EP_IN, USB_ENDPOINT_XFER_BULK, 64, 0 },
+    { EP_OUT, USB_ENDPOINT_XFER_BULK, 64, 0 }
+};
+
+struct usb_model pico_model = {
+    "PicoWifi", 0x20a0, 0x42ec, "020000a1b2c3", pico_ep, 2,
+    pico_control, pico_bulk_in, pico_bulk_out, NULL, NULL
+};
@@ -0,0 +1,58 @@
+/*
+ * model of a PicoWifi adapter, for the host harness
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#ifndef __PICO_H__
+#define __PICO_H__
+
+#include "usb_host.h"
+
+#define PICO_FIFO       4096L       /* device FIFO: most bytes per bulk-in transfer */
+#define PICO_QUEUE      65536L      /* received records waiting for the FIFO */
+
+/*
+ * misbehaviour to inject; rates are per 1000 records or transfers
+ */
+struct pico_scenario {
+    const char *name;
+    int split;                  /* TRUE => bulk-in transfers of random length */
+    int corrupt_rate;           /* records preceded by garbage or damaged */
+    int nak_rate;               /* bulk-in transfers that start a stall */
+    int nak_max;                /* longest stall, in transfers */
+    int tx_stall_rate;          /* bulk-out transfers that fail */
+};
+
+struct pico_stats {
+    unsigned long rx_frames;        /* records queued for the driver */
+    unsigned long rx_bytes;
+    unsigned long rx_overruns;      /* records dropped, queue full or link down */
+    unsigned long rx_corrupted;     /* records damaged by the scenario */
+    unsigned long rx_naks;          /* bulk-in transfers stalled by the scenario */
+    unsigned long tx_transfers;     /* bulk-out transfers */
+    unsigned long tx_frames;        /* valid records in them */
+    unsigned long tx_bytes;
+    unsigned long tx_errors;        /* framing errors (transfer discarded) */
+    unsigned long tx_stalls;        /* transfers failed by the scenario */
+    unsigned long protocol_errors;  /* unexpected control requests */
+};
+
+extern const struct pico_scenario pico_scenarios[];
+extern struct pico_stats pico_stats;
+extern struct usb_model pico_model;
+
+void pico_reset(const struct pico_scenario *scenario, unsigned long seed);
+int pico_rx(const void *frame, long len);
+long pico_rx_pending(void);
+void pico_set_link(int up);
+void pico_set_tx_handler(void (*handler)(const unsigned char *frame, long len));
+
+#endif /* __PICO_H__ */
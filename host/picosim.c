@@ -0,0 +1,251 @@
+/*
+ * picosim: run traffic through the PicoWifi back end and the adapter model
+ *
+ * One traffic profile (default "mixed") is received and transmitted under
+ * each of the model's scenarios (see pico.c), so that the cost of split
+ * records, resynchronisation and stalls can be compared with a clean
+ * link.  Every frame is checked at the other end; frames that never
+ * arrive are reported as lost.  Rates are in host time, so they are only
+ * meaningful relative to each other.
+ *
+ * usage: picosim [-n frames] [-p profile] [-s seed] [scenario ...]
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pico.h"
+#include "picowifi.h"
+#include "traffic.h"
+
+#define IDLE_POLLS  4           /* empty polls that end a burst (enough to resync) */
+
+extern unsigned long memcpy_bytes;
+
+static struct ueth_data ss;
+static unsigned long tx_expect, tx_lost, tx_bad;
+
+/*
+ * check each frame the model receives from the driver: frames may be
+ * lost, but must not be damaged or reordered
+ */
+static void tx_check(const unsigned char *frame, long len)
+{
+    unsigned long seq = traffic_seq(frame, len);
+
+    if ((seq < tx_expect) || (traffic_check(frame, len, seq) != 0)) {
+        tx_bad++;
+        return;
+    }
+    tx_lost += seq - tx_expect;
+    tx_expect = seq + 1;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const struct pico_scenario *scen, const char *dir,
+                unsigned long frames, unsigned long lost, unsigned long bytes,
+                double secs, unsigned long copied, unsigned long transfers,
+                unsigned long resyncs, unsigned long resets, unsigned long errors)
+{
+    double n = frames ? (double)frames : 1.0;
+
+    if (secs <= 0.0)
+        secs = 1e-9;
+
+    printf("%-8s %-2s %8lu %6lu %10.0f %8.2f %10.1f %7.3f %7lu %6lu %6lu\n",
+            scen->name, dir, frames, lost, frames / secs, bytes / secs / 1e6,
+            copied / n, transfers / n, resyncs, resets, errors);
+}
+
+static void run_rx(const struct pico_scenario *scen,
+                const struct traffic_profile *prof, unsigned long total)
+{
+    static unsigned char wrap_buf[2048] __attribute__ ((aligned(4)));
+    unsigned char frame[1514], *pkt;
+    unsigned long queued = 0UL, expect = 0UL, received = 0UL, lost = 0UL;
+    unsigned long bytes = 0UL, errors = 0UL, seq;
+    unsigned long copied, transfers, resyncs, resets;
+    double start, secs = 0.0;
+    long rc, len;
+    int i, idle;
+
+    copied = memcpy_bytes;
+    transfers = host_usb_stats.bulk_in + host_usb_stats.bulk_in_empty;
+    resyncs = ss.rx_resyncs;
+    resets = ss.rx_resets;
+
+    while (queued < total) {
+        for (i = 0; (i < prof->burst) && (queued < total); i++, queued++) {
+            len = traffic_frame(prof, frame, queued);
+            if (pico_rx(frame, len) < 0)
+                break;
+        }
+
+        start = now();
+        for (idle = 0; idle < IDLE_POLLS; ) {
+            rc = picowifi_recv_ptr(&ss, &pkt, wrap_buf, sizeof(wrap_buf));
+            if (rc > 0) {
+                seq = traffic_seq(pkt, rc);
+                if ((seq < expect) || (traffic_check(pkt, rc, seq) != 0)) {
+                    errors++;
+                } else {
+                    lost += seq - expect;
+                    expect = seq + 1;
+                    received++;
+                    bytes += rc;
+                }
+                idle = 0;
+            } else if (rc < 0) {
+                errors++;
+                idle = 0;
+            } else if (pico_rx_pending() == 0) {
+                idle++;
+            }
+        }
+        secs += now() - start;
+
+        if (i == 0)
+            break;          /* the model would not accept anything */
+    }
+    lost += queued - expect;
+
+    report(scen, "rx", received, lost, bytes, secs, memcpy_bytes - copied,
+            host_usb_stats.bulk_in + host_usb_stats.bulk_in_empty - transfers,
+            ss.rx_resyncs - resyncs, ss.rx_resets - resets, errors);
+}
+
+static void run_tx(const struct pico_scenario *scen,
+                const struct traffic_profile *prof, unsigned long total)
+{
+    unsigned long sent = 0UL, bytes = 0UL, errors = 0UL;
+    unsigned long copied, transfers;
+    unsigned char *p;
+    double start;
+    long len;
+    int i;
+
+    tx_expect = tx_lost = tx_bad = 0UL;
+    copied = memcpy_bytes;
+    transfers = host_usb_stats.bulk_out;
+
+    start = now();
+    while (sent < total) {
+        for (i = 0; (i < prof->burst) && (sent < total); i++, sent++) {
+            p = picowifi_send_buffer(&ss);
+            if (!p) {
+                if (picowifi_send_flush(&ss) < 0)
+                    errors++;
+                p = picowifi_send_buffer(&ss);
+            }
+            len = traffic_frame(prof, p, sent);
+            if (picowifi_send(&ss, p, len) < 0)
+                errors++;
+            bytes += len;
+        }
+        if (picowifi_send_flush(&ss) < 0)
+            errors++;
+    }
+    tx_lost += sent - tx_expect;
+
+    /* failed transfers are expected in some scenarios: count the frames lost */
+    report(scen, "tx", sent - tx_lost, tx_lost, bytes, now() - start,
+            memcpy_bytes - copied, host_usb_stats.bulk_out - transfers,
+            0UL, 0UL, tx_bad + pico_stats.tx_errors
+            + ((errors > pico_stats.tx_stalls) ? errors - pico_stats.tx_stalls : 0UL));
+}
+
+static void usage(void)
+{
+    const struct pico_scenario *scen;
+
+    fprintf(stderr, "usage: picosim [-n frames] [-p profile] [-s seed] [scenario ...]\nscenarios:");
+    for (scen = pico_scenarios; scen->name; scen++)
+        fprintf(stderr, " %s", scen->name);
+    fprintf(stderr, "\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const struct pico_scenario *scen;
+    const struct traffic_profile *prof;
+    const char *profile = "mixed";
+    struct usb_device *dev;
+    unsigned char mac[6];
+    unsigned long total = 100000UL, seed = 1UL;
+    int i, first;
+
+    for (i = 1; (i < argc) && (argv[i][0] == '-'); i++) {
+        if ((strcmp(argv[i], "-n") == 0) && (i+1 < argc))
+            total = strtoul(argv[++i], NULL, 0);
+        else if ((strcmp(argv[i], "-p") == 0) && (i+1 < argc))
+            profile = argv[++i];
+        else if ((strcmp(argv[i], "-s") == 0) && (i+1 < argc))
+            seed = strtoul(argv[++i], NULL, 0);
+        else usage();
+    }
+    first = i;
+    for ( ; i < argc; i++) {
+        for (scen = pico_scenarios; scen->name; scen++)
+            if (strcmp(argv[i], scen->name) == 0)
+                break;
+        if (!scen->name)
+            usage();
+    }
+    for (prof = traffic_profiles; prof->name; prof++)
+        if ((strcmp(profile, prof->name) == 0) && prof->num_sizes)
+            break;
+    if (!prof->name)
+        usage();
+
+    pico_reset(NULL, seed);
+    dev = host_usb_attach(&pico_model);
+    picowifi_eth_before_probe(host_usb_api());
+    if (!picowifi_eth_probe(dev, 0, &ss) || !picowifi_eth_get_info(dev, &ss, mac)) {
+        fprintf(stderr, "picosim: probe failed\n");
+        return 1;
+    }
+    ss.tx_batch = 8192L;
+    if (pico_stats.protocol_errors)
+        printf("control requests rejected by the model: %lu\n", pico_stats.protocol_errors);
+
+    printf("profile %s\n", prof->name);
+    printf("%-8s %-2s %8s %6s %10s %8s %10s %7s %7s %6s %6s\n", "scenario", "",
+            "frames", "lost", "pkts/s", "MB/s", "copied/pkt", "usb/pkt",
+            "resyncs", "resets", "errors");
+    for (scen = pico_scenarios; scen->name; scen++) {
+        if (first < argc) {
+            for (i = first; i < argc; i++)
+                if (strcmp(argv[i], scen->name) == 0)
+                    break;
+            if (i == argc)
+                continue;
+        }
+        pico_reset(scen, seed);
+        pico_set_tx_handler(tx_check);
+        run_rx(scen, prof, total);
+        run_tx(scen, prof, total);
+    }
+
+    return 0;
+}
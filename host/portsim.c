@@ -0,0 +1,101 @@
+/*
+ * portsim: run traffic through the whole port driver
+ *
+ * The driver is loaded with one of the adapter models attached (see
+ * drive.c), and a traffic profile is received and sent through it.  The
+ * peer answers the driver's ARP requests, so address resolution is
+ * exercised too.
+ *
+ * Costs are counted over the driver's receive_dgrams() & send_dgrams()
+ * calls only.  Rates are in host time, so they are only meaningful
+ * relative to each other.
+ *
+ * usage: portsim [-n frames] [-p profile] [asix|picowifi]
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "drive.h"
+#include "peer.h"
+#include "traffic.h"
+
+static void report(const char *dir, const struct drive_result *r)
+{
+    double n = r->frames ? (double)r->frames : 1.0;
+    double secs = (r->secs > 0.0) ? r->secs : 1e-9;
+
+    printf("%-2s %8lu %6lu %6lu %10.0f %8.2f %10.1f %9.3f %8.3f %7.3f %6ld\n",
+            dir, r->frames, r->lost + r->dropped, r->bad, r->frames / secs,
+            r->bytes / secs / 1e6, r->copied / n, r->allocs / n, r->frees / n,
+            r->usb / n, r->queue_max);
+}
+
+static void usage(void)
+{
+    const struct traffic_profile *prof;
+
+    fprintf(stderr, "usage: portsim [-n frames] [-p profile] [asix|picowifi]\nprofiles:");
+    for (prof = traffic_profiles; prof->name; prof++)
+        if (prof->num_sizes)
+            fprintf(stderr, " %s", prof->name);
+    fprintf(stderr, "\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const struct adapter *ad = adapters;
+    const struct traffic_profile *prof;
+    const char *profile = "mixed";
+    struct drive_result r;
+    unsigned long total = 100000UL;
+    PORT *port;
+    int i;
+
+    for (i = 1; (i < argc) && (argv[i][0] == '-'); i++) {
+        if ((strcmp(argv[i], "-n") == 0) && (i+1 < argc))
+            total = strtoul(argv[++i], NULL, 0);
+        else if ((strcmp(argv[i], "-p") == 0) && (i+1 < argc))
+            profile = argv[++i];
+        else usage();
+    }
+    if ((i < argc) && (!(ad=drive_adapter(argv[i])) || (i+1 < argc)))
+        usage();
+    for (prof = traffic_profiles; prof->name; prof++)
+        if ((strcmp(profile, prof->name) == 0) && prof->num_sizes)
+            break;
+    if (!prof->name)
+        usage();
+
+    if (!(port=drive_load(ad)))
+        return 1;
+
+    printf("adapter %s, profile %s\n", ad->model->name, prof->name);
+    printf("%-2s %8s %6s %6s %10s %8s %10s %9s %8s %7s %6s\n", "", "frames", "lost", "bad",
+            "pkts/s", "MB/s", "copied/pkt", "alloc/pkt", "free/pkt", "usb/pkt", "queue");
+    drive_rx(ad, port, prof->sizes, prof->num_sizes, prof->burst, total, &r);
+    report("rx", &r);
+    drive_tx(port, prof->sizes, prof->num_sizes, prof->burst, total, &r);
+    report("tx", &r);
+
+    printf("ARP: requests answered %lu, replies from driver %lu, other %lu\n",
+            peer_stats.arp_requests, peer_stats.arp_replies, peer_stats.arp_other);
+    printf("STinG: KRmalloc %lu (%lu failed), KRfree %lu, IP_discard %lu, expired %lu\n",
+            sting_stats.allocs, sting_stats.alloc_failures, sting_stats.frees,
+            sting_stats.discards, sting_stats.expired);
+    printf("       blocks outstanding %ld (max %ld), bytes outstanding %ld (max %ld)\n",
+            sting_stats.blocks, sting_stats.blocks_max, sting_stats.bytes, sting_stats.bytes_max);
+
+    return 0;
+}
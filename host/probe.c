@@ -0,0 +1,131 @@
+/*
+ * probe: attach a null device model to one of the adapter back ends
+ *
+ * The null model answers every control request with zeros and never has
+ * any data to send.  This checks that a back end builds, links and drives
+ * the host USB stand-in; it says nothing about the back end's framing.
+ *
+ * usage: probe asix|picowifi
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "usb_host.h"
+#include "asix.h"
+#include "picowifi.h"
+
+static long null_control(void *priv, int in, unsigned char request,
+                unsigned short value, unsigned short index,
+                void *data, unsigned short size)
+{
+    (void)priv;
+    (void)request;
+    (void)value;
+    (void)index;
+
+    if (in)
+        memset(data, 0, size);
+
+    return size;
+}
+
+static long null_bulk_in(void *priv, int ep, void *data, long len)
+{
+    (void)priv;
+    (void)ep;
+    (void)data;
+    (void)len;
+
+    return 0L;
+}
+
+static long null_bulk_out(void *priv, int ep, const void *data, long len)
+{
+    (void)priv;
+    (void)ep;
+    (void)data;
+
+    return len;
+}
+
+static const struct host_endpoint null_ep[] = {
+    { USB_DIR_IN | 1, USB_ENDPOINT_XFER_BULK, 512, 0 },
+    { 2, USB_ENDPOINT_XFER_BULK, 512, 0 },
+    { USB_DIR_IN | 3, USB_ENDPOINT_XFER_INT, 8, 11 }
+};
+
+static struct usb_model null_model = {
+    "null", 0, 0, "0123456789ab", null_ep, 3,
+    null_control, null_bulk_in, null_bulk_out, NULL, NULL
+};
+
+/*
+ * the back end entry points, as used by usbsting.c
+ */
+struct backend {
+    const char *name;
+    unsigned short vendor;
+    unsigned short product;
+    void (*before_probe)(void *api);
+    long (*probe)(struct usb_device *dev, unsigned int ifnum, struct ueth_data *ss);
+    long (*get_info)(struct usb_device *dev, struct ueth_data *ss, unsigned char *mac);
+    long (*recv_ptr)(struct ueth_data *dev, unsigned char **packet, unsigned char *wrap_buf, unsigned long wrap_len);
+};
+
+static const struct backend backends[] = {
+    { "asix", 0x0b95, 0x772b, asix_eth_before_probe, asix_eth_probe,
+        asix_eth_get_info, asix_recv_ptr },
+    { "picowifi", 0x20a0, 0x42ec, picowifi_eth_before_probe, picowifi_eth_probe,
+        picowifi_eth_get_info, picowifi_recv_ptr },
+    { NULL }
+};
+
+int main(int argc, char **argv)
+{
+    const struct backend *b;
+    struct usb_device *dev;
+    struct ueth_data ss;
+    unsigned char mac[6], wrap[2048], *pkt;
+    long rc;
+
+    for (b = backends; b->name; b++)
+        if (argc == 2 && strcmp(argv[1], b->name) == 0)
+            break;
+    if (!b->name) {
+        fprintf(stderr, "usage: probe asix|picowifi\n");
+        return 2;
+    }
+
+    null_model.vendor = b->vendor;
+    null_model.product = b->product;
+    dev = host_usb_attach(&null_model);
+
+    b->before_probe(host_usb_api());
+    if (!b->probe(dev, 0, &ss)) {
+        printf("%s: probe failed\n", b->name);
+        return 1;
+    }
+    memset(mac, 0, sizeof(mac));
+    rc = b->get_info(dev, &ss, mac);
+    printf("%s: probe ok, get_info %s, MAC %02x:%02x:%02x:%02x:%02x:%02x\n",
+            b->name, rc ? "ok" : "failed", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+    rc = b->recv_ptr(&ss, &pkt, wrap, sizeof(wrap));
+    printf("%s: receive with nothing pending returned %ld\n", b->name, rc);
+
+    printf("control %lu, bulk-in %lu (+%lu empty), bulk-out %lu, interrupt %lu, stalls %lu\n",
+            host_usb_stats.control, host_usb_stats.bulk_in, host_usb_stats.bulk_in_empty,
+            host_usb_stats.bulk_out, host_usb_stats.interrupt, host_usb_stats.stalls);
+
+    return 0;
+}
@@ -0,0 +1,462 @@
+/*
+ * host stand-in for the STinG kernel
+ *
+ * Provides the cookie jar and basepage that the driver's _init() expects,
+ * and the parts of the TPL & STX function tables that the driver uses,
+ * with counts of what it does with them:
+ * . KRmalloc()/KRfree() use the C library, counting calls and bytes, and
+ *   the blocks & bytes outstanding
+ * . IP_discard() frees a dgram and its blocks via KRfree(), counting the
+ *   calls made by the driver
+ * . dgram lifetimes are kept in TIMER_now() units (ms, from the emulated
+ *   200Hz timer), as by STinG
+ * . the port & driver chains each start with an internal entry, to which
+ *   the driver appends its own
+ *
+ * Cookie values are 32 bits, so the objects they point to must be at low
+ * addresses: the harness is linked without PIE (see Makefile).
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sting.h"
+#include "usb_host.h"
+
+#define MAX_VARS        16
+#define MAX_ROUTES      8
+#define MAX_HANDLERS    4
+
+void driver_init(BASPAG *bp);       /* the driver's _init(), renamed by host.h */
+
+struct sting_stats sting_stats;
+
+void *host_p_cookie;                /* what _p_cookie points to (see host.h) */
+
+static int32 cookie_jar[8];
+static BASEPAGE basepage;
+static DRV_LIST drv_list;
+static TPL host_tpl;
+static STX host_stx;
+
+static PORT internal_port;
+static DRIVER internal_driver;
+
+static struct {
+    char name[32];
+    char value[32];
+} vars[MAX_VARS];
+static int num_vars;
+
+static struct {
+    uint32 template;
+    uint32 netmask;
+    PORT *port;
+    uint32 gateway;
+} routes[MAX_ROUTES];
+static int num_routes;
+
+static void cdecl (*handlers[MAX_HANDLERS])(void);
+
+/*
+ * the size of each block is kept in front of it, so that KRfree() can
+ * count the bytes freed
+ */
+typedef union {
+    long size;
+    double align;
+} BLOCK_HDR;
+
+
+/************************************
+*                                   *
+*       TPL FUNCTIONS               *
+*                                   *
+************************************/
+
+static void * cdecl host_KRmalloc(int32 size)
+{
+    BLOCK_HDR *p;
+
+    sting_stats.allocs++;
+
+    /* STinG returns a valid block for size 0 */
+    if ((size < 0L) || !(p=malloc(sizeof(BLOCK_HDR) + size))) {
+        sting_stats.alloc_failures++;
+        return NULL;
+    }
+
+    p->size = size;
+    sting_stats.alloc_bytes += size;
+    if (++sting_stats.blocks > sting_stats.blocks_max)
+        sting_stats.blocks_max = sting_stats.blocks;
+    if ((sting_stats.bytes += size) > sting_stats.bytes_max)
+        sting_stats.bytes_max = sting_stats.bytes;
+
+    return p + 1;
+}
+
+static void cdecl host_KRfree(void *block)
+{
+    BLOCK_HDR *p = block;
+
+    if (!p)
+        return;
+
+    p--;
+    sting_stats.frees++;
+    sting_stats.free_bytes += p->size;
+    sting_stats.blocks--;
+    sting_stats.bytes -= p->size;
+    free(p);
+}
+
+/*
+ * as with STinG, unset variables read as "0"
+ */
+static char * cdecl host_getvstr(char *name)
+{
+    int i;
+
+    for (i = 0; i < num_vars; i++)
+        if (strcmp(vars[i].name, name) == 0)
+            return vars[i].value;
+
+    return "0";
+}
+
+
+/************************************
+*                                   *
+*       STX FUNCTIONS               *
+*                                   *
+************************************/
+
+static int32 cdecl host_TIMER_now(void)
+{
+    return (int32)(host_clock() * 5UL);
+}
+
+static int32 cdecl host_TIMER_elapsed(int32 then)
+{
+    return host_TIMER_now() - then;
+}
+
+static int16 cdecl host_TIMER_call(void cdecl (*handler)(void), int16 flag)
+{
+    int i;
+
+    for (i = 0; i < MAX_HANDLERS; i++) {
+        if (flag == HNDLR_REMOVE) {
+            if (handlers[i] == handler) {
+                handlers[i] = NULL;
+                return TRUE;
+            }
+        } else if (!handlers[i]) {
+            handlers[i] = handler;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void free_dgram(IP_DGRAM *dgram, int16 all_flag)
+{
+    if (all_flag) {
+        host_KRfree(dgram->options);
+        host_KRfree(dgram->pkt_data);
+    }
+    host_KRfree(dgram);
+}
+
+static void cdecl host_IP_discard(IP_DGRAM *dgram, int16 all_flag)
+{
+    sting_stats.discards++;
+    free_dgram(dgram, all_flag);
+}
+
+static void cdecl host_set_dgram_ttl(IP_DGRAM *dgram)
+{
+    dgram->timeout = host_TIMER_now() + dgram->hdr.ttl * 1000L;
+}
+
+/*
+ * if the dgram has outlived its TTL, discard it
+ */
+static int16 cdecl host_check_dgram_ttl(IP_DGRAM *dgram)
+{
+    if ((int32)(host_TIMER_now() - dgram->timeout) < 0L)
+        return E_NORMAL;
+
+    sting_stats.expired++;
+    free_dgram(dgram, TRUE);
+
+    return E_TTLEXCEED;
+}
+
+static void cdecl host_query_chains(void **port, void **drv, void **layer)
+{
+    if (port)
+        *port = &internal_port;
+    if (drv)
+        *drv = &internal_driver;
+    if (layer)
+        *layer = NULL;
+}
+
+static int16 cdecl host_get_route_entry(int16 no, uint32 *template, uint32 *netmask,
+                        PORT **port, uint32 *gateway)
+{
+    if ((no < 0) || (no >= num_routes))
+        return E_NODATA;
+
+    *template = routes[no].template;
+    *netmask = routes[no].netmask;
+    *port = routes[no].port;
+    *gateway = routes[no].gateway;
+
+    return E_NORMAL;
+}
+
+
+static DRV_HDR * cdecl host_get_dftab(char *name)
+{
+    if (strcmp(name, TRANSPORT_DRIVER) == 0)
+        return (DRV_HDR *)&host_tpl;
+    if (strcmp(name, MODULE_DRIVER) == 0)
+        return (DRV_HDR *)&host_stx;
+
+    return NULL;
+}
+
+
+/************************************
+*                                   *
+*       HARNESS INTERFACE           *
+*                                   *
+************************************/
+
+/*
+ * put a pointer in the cookie jar, if it fits
+ */
+static int add_cookie(int n, int32 cookie, void *value)
+{
+    cookie_jar[n*2] = cookie;
+    cookie_jar[n*2+1] = (int32)(uaddr)value;
+
+    return ((uaddr)(long)cookie_jar[n*2+1] == (uaddr)value) ? 0 : -1;
+}
+
+/*
+ * load the driver, as STinG does at startup
+ *
+ * a USB device model should be attached first, since the driver probes
+ * for its device when it registers with the USB stack
+ *
+ * returns the driver's port, or NULL if it did not install one
+ */
+PORT *sting_load(void)
+{
+    host_tpl.module = TRANSPORT_DRIVER;
+    host_tpl.author = "host";
+    host_tpl.version = TCP_DRIVER_VERSION;
+    host_tpl.KRmalloc = host_KRmalloc;
+    host_tpl.KRfree = host_KRfree;
+    host_tpl.getvstr = host_getvstr;
+
+    host_stx.module = MODULE_DRIVER;
+    host_stx.author = "host";
+    host_stx.version = "01.00";
+    host_stx.set_dgram_ttl = host_set_dgram_ttl;
+    host_stx.check_dgram_ttl = host_check_dgram_ttl;
+    host_stx.query_chains = host_query_chains;
+    host_stx.IP_discard = host_IP_discard;
+    host_stx.TIMER_call = host_TIMER_call;
+    host_stx.TIMER_now = host_TIMER_now;
+    host_stx.TIMER_elapsed = host_TIMER_elapsed;
+    host_stx.get_route_entry = host_get_route_entry;
+
+    strcpy(drv_list.magic, MAGIC);
+    drv_list.get_dftab = host_get_dftab;
+
+    internal_port.name = "Internal";
+    internal_port.type = L_INTERNAL;
+    internal_port.active = TRUE;
+    internal_port.next = NULL;
+    internal_driver.name = "Internal";
+    internal_driver.next = NULL;
+
+    memset(cookie_jar, 0, sizeof(cookie_jar));
+    if ((add_cookie(0, STING_COOKIE, &drv_list) < 0)
+     || (add_cookie(1, USB_COOKIE, host_usb_api()) < 0)) {
+        fprintf(stderr, "sting: cookie values must be 32-bit addresses (link with -no-pie)\n");
+        return NULL;
+    }
+    host_p_cookie = cookie_jar;
+
+    basepage.p_lowtpa = (char *)&basepage;
+    basepage.p_bbase = (char *)&basepage;
+    basepage.p_blen = sizeof(basepage);
+    basepage.p_cmdlin[0] = strlen("STinG_Load");
+    strcpy(basepage.p_cmdlin+1, "STinG_Load");
+
+    driver_init(&basepage);
+
+    return internal_port.next;
+}
+
+/*
+ * activate a port, as STinG does when the user enables it
+ */
+int sting_port_up(PORT *port, uint32 ip_addr, uint32 sub_mask)
+{
+    port->ip_addr = ip_addr;
+    port->sub_mask = sub_mask;
+    if (!(*port->driver->set_state)(port, TRUE))
+        return -1;
+    port->active = TRUE;
+
+    return 0;
+}
+
+/*
+ * set a configuration variable (as in DEFAULT.CFG): this must be done
+ * before sting_load()
+ */
+void sting_set_var(const char *name, const char *value)
+{
+    int i;
+
+    for (i = 0; i < num_vars; i++)
+        if (strcmp(vars[i].name, name) == 0)
+            break;
+    if (i == MAX_VARS)
+        return;
+    if (i == num_vars)
+        num_vars++;
+
+    strncpy(vars[i].name, name, sizeof(vars[i].name)-1);
+    strncpy(vars[i].value, value, sizeof(vars[i].value)-1);
+}
+
+int sting_add_route(uint32 template, uint32 netmask, PORT *port, uint32 gateway)
+{
+    if (num_routes == MAX_ROUTES)
+        return -1;
+
+    routes[num_routes].template = template;
+    routes[num_routes].netmask = netmask;
+    routes[num_routes].port = port;
+    routes[num_routes].gateway = gateway;
+    num_routes++;
+
+    return 0;
+}
+
+/*
+ * call the timer handlers, as STinG does periodically
+ */
+void sting_timer(void)
+{
+    int i;
+
+    for (i = 0; i < MAX_HANDLERS; i++) {
+        if (handlers[i]) {
+            sting_stats.timer_calls++;
+            (*handlers[i])();
+        }
+    }
+}
+
+/*
+ * build a dgram, as IP_send() does
+ */
+IP_DGRAM *sting_dgram(uint32 src, uint32 dest, const void *data, int16 length)
+{
+    IP_DGRAM *dgram;
+
+    if (!(dgram=host_KRmalloc(sizeof(IP_DGRAM))))
+        return NULL;
+
+    memset(dgram, 0, sizeof(IP_DGRAM));
+    dgram->hdr.version = 4;
+    dgram->hdr.hd_len = sizeof(IP_HDR) / 4;
+    dgram->hdr.length = sizeof(IP_HDR) + length;
+    dgram->hdr.ttl = 64;
+    dgram->hdr.protocol = P_UDP;
+    dgram->hdr.ip_src = src;
+    dgram->hdr.ip_dest = dest;
+    dgram->options = host_KRmalloc(0L);
+    dgram->opt_length = 0;
+    dgram->pkt_data = host_KRmalloc(length);
+    dgram->pkt_length = length;
+    if (!dgram->options || !dgram->pkt_data) {
+        free_dgram(dgram, TRUE);
+        return NULL;
+    }
+    memcpy(dgram->pkt_data, data, length);
+    host_set_dgram_ttl(dgram);
+
+    return dgram;
+}
+
+/*
+ * append a dgram to a port's send queue
+ */
+void sting_send(PORT *port, IP_DGRAM *dgram)
+{
+    IP_DGRAM **walk;
+    long n = 1L;
+
+    for (walk = &port->send; *walk; walk = &(*walk)->next)
+        n++;
+    dgram->next = NULL;
+    *walk = dgram;
+
+    sting_stats.sent++;
+    if (n > sting_stats.send_max)
+        sting_stats.send_max = n;
+}
+
+/*
+ * take every dgram from a port's receive queue, pass it to the handler
+ * (if any), then discard it
+ *
+ * returns the number of dgrams taken
+ */
+long sting_deliver(PORT *port, void (*handler)(IP_DGRAM *dgram))
+{
+    IP_DGRAM *dgram;
+    long n = 0L;
+
+    while ((dgram=port->receive)) {
+        port->receive = dgram->next;
+        if (++n > sting_stats.receive_max)
+            sting_stats.receive_max = n;
+        sting_stats.delivered++;
+        if (handler)
+            (*handler)(dgram);
+        free_dgram(dgram, TRUE);
+    }
+
+    return n;
+}
+
+/*
+ * free a dgram that the harness did not give to the driver
+ */
+void sting_discard(IP_DGRAM *dgram)
+{
+    free_dgram(dgram, TRUE);
+}
@@ -0,0 +1,59 @@
+/*
+ * host stand-in for the STinG kernel
+ *
+ * This lets the whole port driver (usbsting.c, arpcache.c and a back end)
+ * be loaded and run in a Linux process: sting_load() calls the driver's
+ * _init() just as STinG does, and the harness then plays the part of
+ * STinG's IP layer, queueing dgrams to send and taking received dgrams.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#ifndef __STING_H__
+#define __STING_H__
+
+#include "usbsting.h"
+
+/*
+ * counts maintained by the stand-in
+ */
+struct sting_stats {
+    unsigned long allocs;           /* KRmalloc() calls */
+    unsigned long alloc_bytes;      /*  bytes requested by them */
+    unsigned long alloc_failures;
+    unsigned long frees;            /* blocks freed via KRfree() */
+    unsigned long free_bytes;
+    long blocks;                    /* blocks currently allocated */
+    long blocks_max;
+    long bytes;                     /* bytes currently allocated */
+    long bytes_max;
+    unsigned long discards;         /* IP_discard() calls */
+    unsigned long expired;          /* dgrams discarded by check_dgram_ttl() */
+    unsigned long sent;             /* dgrams queued on port.send */
+    unsigned long delivered;        /* dgrams taken from port.receive */
+    long send_max;                  /* deepest port.send seen */
+    long receive_max;               /* deepest port.receive seen */
+    unsigned long timer_calls;      /* calls of the driver's timer handler */
+};
+
+extern struct sting_stats sting_stats;
+
+PORT *sting_load(void);
+int sting_port_up(PORT *port, uint32 ip_addr, uint32 sub_mask);
+void sting_set_var(const char *name, const char *value);
+int sting_add_route(uint32 template, uint32 netmask, PORT *port, uint32 gateway);
+void sting_timer(void);
+
+IP_DGRAM *sting_dgram(uint32 src, uint32 dest, const void *data, int16 length);
+void sting_send(PORT *port, IP_DGRAM *dgram);
+long sting_deliver(PORT *port, void (*handler)(IP_DGRAM *dgram));
+void sting_discard(IP_DGRAM *dgram);
+
+#endif /* __STING_H__ */
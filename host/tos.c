@@ -0,0 +1,118 @@
+/*
+ * host stand-in for the TOS calls used by the driver
+ *
+ * There is no filesystem for the driver to read its configuration from,
+ * and supervisor mode means nothing here.  Memory is never freed, just
+ * as on the Atari, where the driver stays resident.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <osbind.h>
+
+#define EFILNF  -33L
+
+long host_supexec(long (*func)(void))
+{
+    return func();
+}
+
+long Bconout(int dev, int c)
+{
+    (void)dev;
+
+    if (c != '\r')
+        fputc(c, stderr);
+
+    return 0L;
+}
+
+long Cconws(const char *str)
+{
+    fputs(str, stderr);
+
+    return 0L;
+}
+
+long Drvmap(void)
+{
+    return 0L;
+}
+
+long Fopen(const char *name, int mode)
+{
+    (void)name;
+    (void)mode;
+
+    return EFILNF;
+}
+
+long Fread(long handle, long count, void *buf)
+{
+    (void)handle;
+    (void)count;
+    (void)buf;
+
+    return -1L;
+}
+
+long Fclose(long handle)
+{
+    (void)handle;
+
+    return 0L;
+}
+
+long Malloc(long size)
+{
+    if (size < 0L)
+        return 0L;      /* the largest free block: there is none to report */
+
+    return (long)malloc(size);
+}
+
+long Mxalloc(long size, int mode)
+{
+    (void)mode;
+
+    return Malloc(size);
+}
+
+void Pterm(int code)
+{
+    exit(code ? 1 : 0);
+}
+
+/*
+ * the driver stays resident: just return to the caller of _init()
+ */
+void Ptermres(long size, int code)
+{
+    (void)size;
+    (void)code;
+}
+
+/*
+ * we are always in "supervisor mode"
+ */
+long Super(void *stack)
+{
+    (void)stack;
+
+    return -1L;
+}
+
+void SuperToUser(void *stack)
+{
+    (void)stack;
+}
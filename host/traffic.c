@@ -0,0 +1,97 @@
+/*
+ * traffic profiles for the host harness
+ *
+ * Each frame carries its sequence number and length after the ethernet
+ * header, followed by a pattern derived from the sequence number, so that
+ * the receiving end can check that nothing was lost, reordered, truncated
+ * or corrupted.  The "mixed" profile interleaves broadcast ARP-sized
+ * frames with IP frames of assorted sizes.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#include <string.h>
+
+#include "traffic.h"
+
+#define HDR_LEN     20          /* ethernet header + sequence + length */
+
+static const short flood_sizes[] = { 60 };
+static const short mtu_sizes[] = { 1514 };
+static const short mixed_sizes[] = { 60, 1514, 590, 98, 60, 1514, 342, 1514 };
+
+const struct traffic_profile traffic_profiles[] = {
+    { "flood", flood_sizes, 1, 32 },
+    { "mtu", mtu_sizes, 1, 8 },
+    { "mixed", mixed_sizes, 8, 16 },
+    { "idle", NULL, 0, 0 },
+    { NULL }
+};
+
+static const unsigned char local_mac[6] = { 0x00, 0x0e, 0xc6, 0x88, 0x77, 0x2b };
+static const unsigned char peer_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+/*
+ * build frame 'seq' of a profile, returning its length
+ */
+long traffic_frame(const struct traffic_profile *prof, unsigned char *frame, unsigned long seq)
+{
+    long len = prof->sizes[seq % prof->num_sizes];
+    int arp = (prof->num_sizes > 1) && (len == 60);
+    long i;
+
+    if (arp)
+        memset(frame, 0xff, 6);
+    else memcpy(frame, local_mac, 6);
+    memcpy(frame+6, peer_mac, 6);
+    frame[12] = 0x08;
+    frame[13] = arp ? 0x06 : 0x00;
+    frame[14] = seq >> 24;
+    frame[15] = seq >> 16;
+    frame[16] = seq >> 8;
+    frame[17] = seq;
+    frame[18] = len >> 8;
+    frame[19] = len;
+    for (i = HDR_LEN; i < len; i++)
+        frame[i] = seq + i;
+
+    return len;
+}
+
+/*
+ * return the sequence number of a frame
+ */
+unsigned long traffic_seq(const unsigned char *frame, long len)
+{
+    if (len < HDR_LEN)
+        return 0UL;
+
+    return ((unsigned long)frame[14] << 24) | ((unsigned long)frame[15] << 16)
+        | (frame[16] << 8) | frame[17];
+}
+
+/*
+ * check that a frame is frame 'seq', intact: returns 0 if so
+ */
+int traffic_check(const unsigned char *frame, long len, unsigned long seq)
+{
+    long i;
+
+    if (len < HDR_LEN)
+        return -1;
+
+    if ((traffic_seq(frame, len) != seq) || (((frame[18] << 8) | frame[19]) != len))
+        return -1;
+    for (i = HDR_LEN; i < len; i++)
+        if (frame[i] != (unsigned char)(seq + i))
+            return -1;
+
+    return 0;
+}
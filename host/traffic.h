@@ -0,0 +1,30 @@
+/*
+ * traffic profiles for the host harness
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#ifndef __TRAFFIC_H__
+#define __TRAFFIC_H__
+
+struct traffic_profile {
+    const char *name;
+    const short *sizes;         /* frame sizes, used in turn */
+    int num_sizes;              /* 0 => idle link */
+    int burst;                  /* frames queued at a time */
+};
+
+extern const struct traffic_profile traffic_profiles[];
+
+long traffic_frame(const struct traffic_profile *prof, unsigned char *frame, unsigned long seq);
+unsigned long traffic_seq(const unsigned char *frame, long len);
+int traffic_check(const unsigned char *frame, long len, unsigned long seq);
+
+#endif /* __TRAFFIC_H__ */
@@ -0,0 +1,304 @@
+/*
+ * host stand-in for the FreeMiNT USB stack
+ *
+ * Implements the parts of struct usb_module_api used by the driver and
+ * the adapter back ends, by passing each transfer to the attached device
+ * model (see usb_host.h).  Only one device can be attached at a time.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "usb_host.h"
+
+/* usb_api.h maps these names onto calls through the api pointer */
+#undef usb_control_msg
+#undef usb_bulk_msg
+#undef usb_submit_int_msg
+#undef usb_maxpacket
+#undef usb_set_interface
+#undef udd_register
+#undef usb_disable_asynch
+
+struct host_usb_stats host_usb_stats;
+
+static struct usb_device device;
+static const struct usb_model *model;
+static struct uddif *driver;        /* class driver registered with us */
+static long asynch_disabled;
+
+/*
+ * interrupt transfer submitted by the driver, not yet completed
+ */
+static struct {
+    int pending;
+    int ep;
+    void *buffer;
+    long len;
+} irq;
+
+/*
+ * the emulated 200Hz timer
+ *
+ * Time advances by one tick each time the driver reads it, so delay
+ * loops finish at once and periodic work (such as link status polling)
+ * happens every few calls.  The harness may also advance it explicitly.
+ */
+static unsigned long clock_ticks;
+
+unsigned long host_clock(void)
+{
+    return clock_ticks++;
+}
+
+void host_clock_advance(unsigned long ticks)
+{
+    clock_ticks += ticks;
+}
+
+
+/*
+ * complete a pending interrupt transfer, if the model has data for it
+ */
+void host_usb_poll(void)
+{
+    long n;
+
+    if (!irq.pending || !model || !model->int_in)
+        return;
+
+    n = model->int_in(model->priv, irq.ep, irq.buffer, irq.len);
+    if (n == 0)
+        return;             /* the device NAKs: leave it pending */
+
+    irq.pending = 0;
+    device.irq_status = (n < 0) ? 1UL : 0UL;
+    device.irq_act_len = (n < 0) ? 0L : n;
+    if (n < 0)
+        host_usb_stats.stalls++;
+    else host_usb_stats.interrupt++;
+
+    if (device.irq_handle)
+        device.irq_handle(&device);
+}
+
+
+static long _cdecl host_control_msg(struct usb_device *dev, unsigned long pipe,
+            unsigned char request, unsigned char requesttype,
+            unsigned short value, unsigned short idx,
+            void *data, unsigned short size, long timeout)
+{
+    long n;
+
+    (void)pipe;
+    (void)timeout;
+
+    host_usb_stats.control++;
+    n = model->control(model->priv, (requesttype & USB_DIR_IN) ? 1 : 0,
+                        request, value, idx, data, size);
+    if (n < 0) {
+        host_usb_stats.stalls++;
+        dev->status = USB_ST_STALLED;
+        dev->act_len = 0;
+        return -1;
+    }
+
+    dev->status = 0;
+    dev->act_len = n;
+
+    return n;
+}
+
+
+static long _cdecl host_bulk_msg(struct usb_device *dev, unsigned long pipe,
+            void *data, long len, long *actual_length, long timeout,
+            long flags)
+{
+    int ep = usb_pipeendpoint(pipe);
+    long n;
+
+    (void)dev;
+
+    host_usb_poll();        /* interrupt transfers complete in the background */
+
+    *actual_length = 0;
+
+    if (usb_pipeout(pipe)) {
+        n = model->bulk_out(model->priv, ep, data, len);
+        if (n < 0) {
+            host_usb_stats.stalls++;
+            return -1;
+        }
+        host_usb_stats.bulk_out++;
+        host_usb_stats.bytes_out += n;
+        *actual_length = n;
+        return 0;
+    }
+
+    n = model->bulk_in(model->priv, ep, data, len);
+    if (n < 0) {
+        host_usb_stats.stalls++;
+        return -1;
+    }
+    if (n == 0) {
+        /*
+         * nothing to receive: the real stack returns at once when asked
+         * to, otherwise only when the timeout expires
+         */
+        host_usb_stats.bulk_in_empty++;
+        if (!(flags & USB_BULK_FLAG_EARLY_TIMEOUT))
+            host_clock_advance((unsigned long)timeout / 5);
+        return -1;
+    }
+
+    host_usb_stats.bulk_in++;
+    host_usb_stats.bytes_in += n;
+    *actual_length = n;
+
+    return 0;
+}
+
+
+static long _cdecl host_submit_int_msg(struct usb_device *dev, unsigned long pipe,
+            void *buffer, long transfer_len, long interval)
+{
+    (void)dev;
+    (void)interval;
+
+    if (irq.pending)
+        return -1;
+
+    irq.pending = 1;
+    irq.ep = usb_pipeendpoint(pipe);
+    irq.buffer = buffer;
+    irq.len = transfer_len;
+
+    host_usb_poll();
+
+    return 0;
+}
+
+
+static long _cdecl host_maxpacket(struct usb_device *dev, unsigned long pipe)
+{
+    int ep = usb_pipeendpoint(pipe);
+
+    return usb_pipeout(pipe) ? dev->epmaxpacketout[ep] : dev->epmaxpacketin[ep];
+}
+
+
+static long _cdecl host_set_interface(struct usb_device *dev, long interface, long alternate)
+{
+    (void)dev;
+
+    return (interface == 0 && alternate == 0) ? 0 : -1;
+}
+
+
+/*
+ * register a class driver, and offer it the attached device (if any)
+ *
+ * as with the real stack, a device that the driver declines is not an
+ * error: it is only reported via the driver's own state
+ */
+static long _cdecl host_udd_register(struct uddif *u)
+{
+    driver = u;
+    if (model && u->probe)
+        u->probe(&device, 0);
+
+    return 0L;
+}
+
+
+static long _cdecl host_disable_asynch(long disable)
+{
+    long old = asynch_disabled;
+
+    asynch_disabled = disable;
+
+    return old;
+}
+
+
+static struct usb_module_api host_api;
+
+struct usb_module_api *host_usb_api(void)
+{
+    host_api.usb_control_msg = host_control_msg;
+    host_api.usb_bulk_msg = host_bulk_msg;
+    host_api.usb_submit_int_msg = host_submit_int_msg;
+    host_api.usb_maxpacket = host_maxpacket;
+    host_api.usb_set_interface = host_set_interface;
+    host_api.udd_register = host_udd_register;
+    host_api.usb_disable_asynch = host_disable_asynch;
+
+    return &host_api;
+}
+
+
+/*
+ * build the usb_device that the driver sees for a model
+ */
+struct usb_device *host_usb_attach(const struct usb_model *m)
+{
+    struct usb_interface *iface;
+    int i;
+
+    memset(&device, 0, sizeof(device));
+    memset(&irq, 0, sizeof(irq));
+
+    device.devnum = 1;
+    device.speed = USB_SPEED_HIGH;
+    device.maxpacketsize = PACKET_SIZE_64;
+    strncpy(device.prod, m->name, sizeof(device.prod)-1);
+    if (m->serial)
+        strncpy(device.serial, m->serial, sizeof(device.serial)-1);
+    device.descriptor.idVendor = m->vendor;
+    device.descriptor.idProduct = m->product;
+    device.epmaxpacketin[0] = device.epmaxpacketout[0] = 64;
+
+    device.config.no_of_if = 1;
+    iface = &device.config.if_desc[0];
+    iface->desc.bInterfaceNumber = 0;
+    iface->desc.bNumEndpoints = m->num_ep;
+    iface->no_of_ep = m->num_ep;
+    iface->num_altsetting = 1;
+
+    for (i = 0; i < m->num_ep; i++) {
+        const struct host_endpoint *ep = &m->ep[i];
+        int num = ep->address & USB_ENDPOINT_NUMBER_MASK;
+
+        iface->ep_desc[i].bLength = USB_DT_ENDPOINT_SIZE;
+        iface->ep_desc[i].bDescriptorType = USB_DT_ENDPOINT;
+        iface->ep_desc[i].bEndpointAddress = ep->address;
+        iface->ep_desc[i].bmAttributes = ep->type;
+        iface->ep_desc[i].wMaxPacketSize = ep->maxpacket;
+        iface->ep_desc[i].bInterval = ep->interval;
+        if (ep->address & USB_DIR_IN)
+            device.epmaxpacketin[num] = ep->maxpacket;
+        else device.epmaxpacketout[num] = ep->maxpacket;
+    }
+
+    model = m;
+
+    return &device;
+}
+
+
+void host_usb_detach(void)
+{
+    if (model && driver && driver->disconnect)
+        driver->disconnect(&device);
+    model = NULL;
+    irq.pending = 0;
+}
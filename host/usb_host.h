@@ -0,0 +1,84 @@
+/*
+ * host stand-in for the FreeMiNT USB stack
+ *
+ * This lets the adapter back ends (asix.c, picowifi.c) run unmodified in
+ * a Linux process, talking to an in-process model of the adapter instead
+ * of real hardware.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#ifndef __USB_HOST_H__
+#define __USB_HOST_H__
+
+#include "usb.h"
+#include "usb_api.h"
+
+/*
+ * an endpoint of the modelled interface (other than endpoint 0)
+ */
+struct host_endpoint {
+    unsigned char address;          /* including USB_DIR_IN */
+    unsigned char type;             /* USB_ENDPOINT_XFER_xxx */
+    unsigned short maxpacket;
+    unsigned char interval;         /* interrupt endpoints only */
+};
+
+/*
+ * a device model
+ *
+ * All data callbacks return the number of bytes transferred, 0 if the
+ * device has nothing to send (bulk-in/interrupt-in: the device NAKs), or
+ * a negative value if the endpoint stalls.
+ */
+struct usb_model {
+    const char *name;
+    unsigned short vendor;
+    unsigned short product;
+    const char *serial;
+    const struct host_endpoint *ep;
+    int num_ep;
+    long (*control)(void *priv, int in, unsigned char request,
+                    unsigned short value, unsigned short index,
+                    void *data, unsigned short size);
+    long (*bulk_in)(void *priv, int ep, void *data, long len);
+    long (*bulk_out)(void *priv, int ep, const void *data, long len);
+    long (*int_in)(void *priv, int ep, void *data, long len);
+    void *priv;
+};
+
+/*
+ * transfer counts, maintained by the stand-in
+ */
+struct host_usb_stats {
+    unsigned long control;          /* control transfers */
+    unsigned long bulk_in;          /* bulk-in transfers that returned data */
+    unsigned long bulk_in_empty;    /* bulk-in transfers that found nothing */
+    unsigned long bulk_out;         /* bulk-out transfers */
+    unsigned long interrupt;        /* completed interrupt transfers */
+    unsigned long bytes_in;         /* bulk-in bytes */
+    unsigned long bytes_out;        /* bulk-out bytes */
+    unsigned long stalls;           /* transfers failed by the model */
+};
+
+extern struct host_usb_stats host_usb_stats;
+
+struct usb_module_api *host_usb_api(void);
+struct usb_device *host_usb_attach(const struct usb_model *model);
+void host_usb_detach(void);
+void host_usb_poll(void);
+
+/*
+ * the emulated 200Hz system timer (see host.h)
+ */
+unsigned long host_clock(void);
+void host_clock_advance(unsigned long ticks);
+
+#endif /* __USB_HOST_H__ */
@@ -0,0 +1,33 @@
+/*
+ * host stand-in for driver/utility.c
+ *
+ * Only the instrumentation is needed: the C library provides the rest.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+#include <string.h>
+
+unsigned long memcpy_bytes;     /* instrumentation: total bytes copied */
+
+void *host_memcpy(void *dest, const void *src, unsigned long n)
+{
+    memcpy_bytes += n;
+
+    return memcpy(dest, src, n);
+}
+
+/*
+ * the C library's copy routines are used whatever the CPU
+ */
+void copy_init(long cpu)
+{
+    (void)cpu;
+}
@@ -36,7 +36,7 @@ typedef  struct port_desc
 /*--------------------------------------------------------------------------*/
 typedef  struct drv_desc
 {   int16 cdecl (* set_state) (PORT *, int16);      /* Setup and shutdown   */
-    int16 cdecl (* cntrl) (PORT *, uint32, int16);  /* Control functions    */
+    int16 cdecl (* cntrl) (PORT *, uaddr, int16);   /* Control functions    */
     void  cdecl (* send) (PORT *);                  /* Send packets         */
     void  cdecl (* receive) (PORT *);               /* Receive packets      */
     char                *name;      /* Name of driver                       */
@@ -114,6 +114,13 @@ extern STX *stx;
 #define get_route_entry(a,b,c,d,e)       (*stx->get_route_entry)(a,b,c,d,e)
 #define set_route_entry(a,b,c,d,e)       (*stx->set_route_entry)(a,b,c,d,e)
 /*--------------------------------------------------------------------------*/
+/*  Handler flag values for TIMER_call().                                   */
+/*--------------------------------------------------------------------------*/
+#define HNDLR_SET         0         /* Set new handler if space         */
+#define HNDLR_FORCE       1         /* Force new handler to be set      */
+#define HNDLR_REMOVE      2         /* Remove handler entry             */
+#define HNDLR_QUERY       3         /* Inquire about handler entry      */
+/*--------------------------------------------------------------------------*/
 #endif  /* MOD_DRIVER */
 /*--------------------------------------------------------------------------*/
 #endif  /* STING_PORT_H */
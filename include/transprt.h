@@ -10,14 +10,22 @@
 #define STING_TRANSPRT_H
 
 /*--------------------------------------------------------------------------*/
-/*  Data types used throughout STinG for portability. (here for Pure_C)     */
+/*  Data types used throughout STinG for portability.                       */
+/*  These do not depend on the size of int, so they are correct with and   */
+/*  without -mshort, and also for native builds on 32/64-bit hosts.        */
 /*--------------------------------------------------------------------------*/
 typedef          char  int8;        /*   Signed  8 bit (char)           */
 typedef unsigned char uint8;        /* Unsigned  8 bit (byte, octet)    */
-typedef          int   int16;       /*   Signed 16 bit (int)            */
-typedef unsigned int  uint16;       /* Unsigned 16 bit (word)           */
+typedef          short int16;       /*   Signed 16 bit (word)           */
+typedef unsigned short uint16;      /* Unsigned 16 bit (word)           */
+#if defined(__SIZEOF_LONG__) && (__SIZEOF_LONG__ > 4)
+typedef          int   int32;       /*   Signed 32 bit                  */
+typedef unsigned int  uint32;       /* Unsigned 32 bit (longword)       */
+#else
 typedef          long  int32;       /*   Signed 32 bit                  */
 typedef unsigned long uint32;       /* Unsigned 32 bit (longword)       */
+#endif
+typedef unsigned long uaddr;        /* Unsigned, holds a pointer        */
 /*--------------------------------------------------------------------------*/
 #ifndef TRUE
 #define TRUE    1
@@ -310,7 +318,7 @@ typedef  struct tpl
     int16   cdecl   (* ICMP_handler) (int16 cdecl (*) (IP_DGRAM *), int16);
     void    cdecl   (* ICMP_discard) (IP_DGRAM *);
     int16   cdecl   (* TCP_info) (int16, TCPIB *);
-    int16   cdecl   (* cntrl_port) (char *, uint32, int16);
+    int16   cdecl   (* cntrl_port) (char *, uaddr, int16);
     int16   cdecl   (* UDP_info) (int16, UDPIB *);
     int16   cdecl   (* RAW_open)(uint32);
     int16   cdecl   (* RAW_close)(int16);
@@ -47,6 +47,13 @@ typedef unsigned char uchar;
 #define ETH_MIN_DLEN    2           /* minimum data length */
 #define ETH_MAX_DLEN    1500        /* maximum data length */
 
+/*
+ *  the following structures mirror on-the-wire layouts: 68000 alignment
+ *  (max 2 bytes) is specified explicitly, so that they are also correct
+ *  when compiled for a host with stricter alignment
+ */
+#pragma pack(push,2)
+
 typedef struct {                /* packet header */
      char destination[ETH_ALEN];    /* Destination hardware address */
      char source[ETH_ALEN];         /* Source hardware address */
@@ -84,13 +91,23 @@ typedef struct {                /* ARP ethernet packet */
     //char     padbytes[ETH_MIN_LEN-sizeof(ENET_HDR)-sizeof(ARP)];
 } ARP_PACKET;
 
+#pragma pack(pop)
+
 
 /*
  *  manifest constants
  */
-#define hz_200          (*(unsigned long *) 0x4baL)
+#ifndef hz_200                      /* the host build supplies its own */
+#define hz_200          (*(volatile uint32 *) 0x4baL)
+#endif
+#define mfp_tcdr        (*(volatile uint8 *) 0xfffffa23L)  /* MFP timer C data */
+#define TIMER_C_COUNTS  192L            /* timer C counts per hz_200 tick */
+#define TIMER_C_HZ      (200L*TIMER_C_COUNTS)
+#ifndef _p_cookie
 #define _p_cookie       0x5a0L
+#endif
 
+#define CPU_COOKIE      0x5f435055L     /* '_CPU' */
 #define FRB_COOKIE      0x5f465242L     /* '_FRB' */
 #define STING_COOKIE    0x5354694bL     /* 'STiK' */
 #define USB_COOKIE      0x5f555342L     /* '_USB' */
@@ -109,65 +126,156 @@ typedef struct
 {
     unsigned char hwaddr[ETH_ALEN]; /* default MAC address */
     unsigned char macaddr[ETH_ALEN];/* current MAC address */
-    long arp_entries;               /* number of active entries in ARP cache */
-    long trace_entries;             /* number of entries in trace table */
+    int32 arp_entries;              /* number of active entries in ARP cache */
+    int32 trace_entries;            /* number of entries in trace table */
     struct
     {
-        long total_packets;
-        long failed;
+        int32 total_packets;
+        int32 failed;
     } read;
     struct
     {
-        long total_packets;
-        long good_packets;
-        long bad_packets;
+        int32 total_packets;
+        int32 good_packets;
+        int32 bad_packets;
     } receive;
     struct
     {
-        long broadcast_ip_packets;
-        long normal_ip_packets;
-        long arp_packets;
-        long bad_ip_packets;
-        long bad_arp_packets;
+        int32 broadcast_ip_packets;
+        int32 normal_ip_packets;
+        int32 arp_packets;
+        int32 bad_ip_packets;
+        int32 bad_arp_packets;
     } process;
     struct
     {
-        long total_packets;
-        long failed;                /* write_device() returned error */
+        int32 total_packets;
+        int32 failed;               /* write_device() returned error, or packet lost in failed transfer */
     } write;
     struct
     {
-        long dequeued;
-        long bad_length;
-        long bad_host;
-        long bad_network;
-        long ip_packets;
-        long arp_packets;
-        long arp_packets_err;
+        int32 dequeued;
+        int32 bad_length;
+        int32 bad_host;
+        int32 bad_network;
+        int32 ip_packets;
+        int32 arp_packets;
+        int32 arp_packets_err;
     } send;
     struct
     {
-        long input_errors;          /* ARP dgram counts */
-        long opcode_errors;
-        long requests_received;
-        long answers_received;
-        long wait_queued;           /* normal dgrams queued waiting for ARP */
-        long wait_dequeued;         /* dequeued */
-        long wait_requeued;         /* requeued */
+        int32 input_errors;         /* ARP dgram counts */
+        int32 opcode_errors;
+        int32 requests_received;
+        int32 answers_received;
+        int32 wait_queued;          /* normal dgrams queued waiting for ARP */
+        int32 wait_dequeued;        /* dequeued */
+        int32 wait_requeued;        /* requeued */
     } arp;
+    /*
+     * the following were added in version 00.60: CTL_ETHER_GET_STAT only
+     * returns the fields above, so that it still works with older tools,
+     * while CTL_ETHER_GET_XSTAT returns the complete structure
+     */
+    int32 arp_capacity;             /* total number of entries in ARP cache */
+    struct
+    {
+        int32 requests_sent;        /* all ARP requests sent: initial, retries, refreshes, gratuitous */
+        int32 pending_evicted;      /* destinations dropped from full pending table */
+        int32 retries;              /* ARP requests retransmitted by timer */
+        int32 timeouts;             /* destinations given up on after last retry */
+        int32 negative_hits;        /* dgrams failed because destination is negatively cached */
+        int32 cache_expired;        /* ARP cache entries expired */
+        int32 cache_evicted;        /* ARP cache entries replaced because cache was full */
+        int32 cache_refreshes;      /* ARP requests sent to refresh entries in use */
+        int32 cache_lookups;        /* ARP cache lookups, */
+        int32 cache_fast_hits;      /*  of which satisfied by the last entry found */
+        int32 cache_probes;         /* entries examined by the remaining lookups */
+        int32 gratuitous;           /* gratuitous ARPs sent when port opened */
+        int32 gateway_probes;       /* gateways resolved in advance when port opened */
+    } resolve;
+    struct
+    {
+        int32 bulk_in;              /* bulk-in transfers */
+        int32 bulk_in_empty;        /* bulk-in transfers that returned no data */
+        int32 bulk_in_bytes;
+        int32 bulk_out;             /* bulk-out transfers */
+        int32 bulk_out_bytes;
+        int32 bulk_errors;          /* failed transfers (either direction) */
+        int32 bulk_in_skipped;      /* bulk-in transfers not attempted because link was down */
+        int32 int_in;               /* interrupt (link status) transfers */
+        int32 int_errors;           /* failed interrupt transfers */
+        int32 link_changes;         /* link state changes reported by the chip */
+    } usb;
+    struct
+    {
+        int32 wrapped;              /* packets wrapped at end of receive buffer */
+        int32 resets;               /* receive buffer discarded after framing error */
+        int32 resyncs;              /* PicoWifi header resynchronisation attempts */
+    } framing;
+    struct
+    {
+        int32 empty;                /* receive_dgrams() calls that found nothing */
+        int32 skipped;              /* receive_dgrams() calls that did not read (idle backoff) */
+        int32 interval;             /* current ms between reads (0 => every call), */
+        int32 max_interval;         /*  and its upper limit */
+        int32 budget_exhausted;     /* receive_dgrams() calls that stopped at the packet/byte limit */
+    } poll;
+    struct
+    {
+        int32 allocs;               /* KRmalloc() calls */
+        int32 alloc_failures;
+        int32 alloc_bytes;
+        int32 discards;             /* IP_discard() calls */
+    } memory;
+    struct
+    {
+        int32 send;                 /* current queue depths, */
+        int32 receive;              /*  set when the statistics are fetched */
+        int32 arpwait;
+        int32 send_max;             /* high-water marks: most dgrams taken from send queue in one call, */
+        int32 receive_max;          /*  most dgrams appended to receive queue since it was last empty, */
+        int32 arpwait_max;          /*  longest arpwait queue */
+    } queue;
+    struct
+    {
+        int32 elapsed;              /* ms since statistics were cleared */
+        int32 copied_bytes;         /* bytes moved by memcpy() */
+#define USBNET_SIZE_BUCKETS     5   /* by length: <128, <256, <512, <1024, <=1514 */
+        int32 rx_size[USBNET_SIZE_BUCKETS];
+        int32 tx_size[USBNET_SIZE_BUCKETS];
+#define USBNET_BURST_BUCKETS    7   /* by packets per call: 1, 2-3, 4-7, ... 32-63, 64+ */
+        int32 rx_burst[USBNET_BURST_BUCKETS];
+        int32 tx_burst[USBNET_BURST_BUCKETS];
+        int32 tx_batch[USBNET_BURST_BUCKETS];   /* by packets per bulk-out transfer */
+    } profile;
+    /*
+     * MFP timer C counts (38400Hz, i.e. 26us each) elapsed while executing
+     * the following: only maintained if the driver is built with PROFILE
+     */
+    struct
+    {
+        int32 receive;              /* receive_dgrams() */
+        int32 send;                 /* send_dgrams() */
+        int32 read;                 /* read_device(), i.e. the chip backend */
+        int32 write;                /* write_device() */
+        int32 ip;                   /* process_ip() */
+        int32 output;               /* process_output() called from send_dgrams() */
+        int32 hz;                   /* TIMER_C_HZ if built with PROFILE, else 0 */
+    } ticks;
 } USBNET_STATS;
 
 #define USBNET_TRACE_LEN   52
 typedef struct
 {
-    unsigned long time;
-    long rc;
+    uint32 time;
+    int32 rc;
     char type;
 #define TRACE_MAC_GET       'G'
 #define TRACE_READ          'R'
 #define TRACE_WRITE         'W'
     char reserved;
-    short length;
+    int16 length;
     uchar data[USBNET_TRACE_LEN];
 } USBNET_TRACE;
 
@@ -177,6 +285,22 @@ typedef struct                  /* data returned by CTL_ETHER_GET_ARPTABLE */
     unsigned char ether[ETH_ALEN];  /* EtherNet station address */
 } ARP_INFO;
 
+typedef struct                  /* data returned by CTL_ETHER_GET_XARPTABLE */
+{
+    uint32 ip_addr;                 /* IP address */
+    unsigned char ether[ETH_ALEN];  /* EtherNet station address */
+    uint16 flags;
+#define ARP_INFO_PINNED     0x0001  /* entry is never evicted or expired */
+    int32 age;                      /* seconds since entry was last confirmed */
+} ARP_XINFO;
+
+/*
+ *  the STinG & USB APIs require 16-bit words and 32-bit longwords:
+ *  the following typedefs fail to compile if that is not the case
+ */
+typedef char int16_must_be_2_bytes[(sizeof(int16) == 2) ? 1 : -1];
+typedef char int32_must_be_4_bytes[(sizeof(int32) == 4) ? 1 : -1];
+
 /*
  *    additional function codes for cntrl_port()
  */
@@ -186,5 +310,7 @@ typedef struct                  /* data returned by CTL_ETHER_GET_ARPTABLE */
 #define CTL_ETHER_CLR_ARPTABLE  (('E' << 8) | 'B')  /* clears ARP table */
 #define CTL_ETHER_GET_TRACE     (('E' << 8) | 'X')  /* gets trace table */
 #define CTL_ETHER_CLR_TRACE     (('E' << 8) | 'Y')  /* clears trace table */
+#define CTL_ETHER_GET_XSTAT     (('E' << 8) | 's')  /* returns a copy of all of USBNET_STATS (00.60 & later) */
+#define CTL_ETHER_GET_XARPTABLE (('E' << 8) | 'a')  /* gets ARP table as ARP_XINFO (00.60 & later) */
 
 #endif
@@ -1,17 +1,20 @@
 /*
  *  uatool: control program for USB_NET.STX
  *
- *  syntax: uatool [-c[a][t]] [filename]
+ *  syntax: uatool [-c[a][t]] [-s] [filename]
  *      default: report statistics, plus arp cache contents, plus trace table (if present)
  *      -c  clears the statistics counters instead
  *      -ca clears counters & arp cache
  *      -ct clears counters & trace
  *      -cat clears everything
+ *      -s  reports the performance counters as one CSV line (plus header) instead
  *      output is to stdout, unless a filename is present, in which
  *      case the report will be written to it instead
  *
  *  v0.40   Jun/2018    roger burrows
  *      Initial version, based on unpublished SCSILINK code
+ *  v0.60   Oct/2026
+ *      Report the extended statistics of driver version 00.60
  */
 #include <stdio.h>
 #include <stdlib.h>
@@ -25,7 +28,8 @@
 #define min(a,b)    ((a)<(b)?(a):(b))
 
 #define PROGRAM "uatool"
-#define VERSION "v0.40"
+#define VERSION "v0.60"
+#define DRIVER_VERSION  "00.60"     /* oldest driver supporting CTL_ETHER_GET_XSTAT etc */
 
 #define PORTNAME_LENGTH 20
 #define ETH_HDR_LEN     (2*ETH_ALEN+2)
@@ -34,6 +38,9 @@
  *  internal function prototypes
  */
 static int display_arp(char *portname,USBNET_STATS *stats);
+static void display_csv(USBNET_STATS *stats);
+static void display_profile(USBNET_STATS *stats);
+static void display_time(char *name,long ticks,long calls);
 static void display_statistics(char *portname,USBNET_STATS *stats);
 static int display_trace(char *portname,USBNET_STATS *stats);
 static void display_trace_entry(USBNET_TRACE *t);
@@ -52,13 +59,16 @@ static char *format_macaddr(uchar *macaddr);
  *  globals
  */
 USBNET_STATS stats;
-ARP_INFO *arp;
+ARP_XINFO *arp;
 USBNET_TRACE *trace;
 int clear_stats = 0;
 int clear_arp = 0;
 int clear_trace = 0;
+int csv_output = 0;
 FILE *report = NULL;
 char driver_version[10] = "??.??";
+uint16 driver_date = 0;              /* GEMDOS format */
+int extended = 0;                   /* driver supports CTL_ETHER_GET_XSTAT etc */
 char *portname = BASE_PORTNAME;
 
 TPL *tpl;
@@ -80,7 +90,7 @@ int n, rc, rc2;
 
     fprintf(stderr,"%s %s: Copyright 2018 by Roger Burrows\r\n",PROGRAM,VERSION);
 
-    while((n=getopt(argc,argv,"c::")) != -1) {
+    while((n=getopt(argc,argv,"c::s")) != -1) {
         switch(n) {
         case 'c':
             if (optarg) {
@@ -94,6 +104,9 @@ int n, rc, rc2;
             }
             clear_stats++;
             break;
+        case 's':
+            csv_output++;
+            break;
         default:
             usage();
         }
@@ -119,9 +132,11 @@ int n, rc, rc2;
     for ( ; ports; ports = ports->next) {
         if (stricmp(portname,ports->name) == 0) {
             strcpy(driver_version,ports->driver->version);
+            driver_date = ports->driver->date;
             break;
         }
     }
+    extended = isdigit(driver_version[0]) && (strcmp(driver_version,DRIVER_VERSION) >= 0);
 
     if (optind < argc)
         report = fopen(argv[optind],"wa");
@@ -150,12 +165,27 @@ int n, rc, rc2;
         return min(rc,rc2);
     }
 
-    rc = cntrl_port(portname,(long)&stats,CTL_ETHER_GET_STAT);
+    /*
+     *  older drivers only return the statistics that existed before
+     *  version 00.60, which do not include the performance counters
+     */
+    if (csv_output && !extended) {
+        fprintf(report,"%s: driver version %s, version %s or later is required for -s\r\n",
+                portname,driver_version,DRIVER_VERSION);
+        return -1;
+    }
+
+    rc = cntrl_port(portname,(long)&stats,extended?CTL_ETHER_GET_XSTAT:CTL_ETHER_GET_STAT);
     if (rc != 0) {
         fprintf(report,"%s: cannot get statistics\r\n",portname);
         return rc;
     }
 
+    if (csv_output) {
+        display_csv(&stats);
+        return 0;
+    }
+
     display_statistics(portname,&stats);
 
     rc2 = display_arp(portname,&stats);
@@ -170,24 +200,42 @@ int n, rc, rc2;
 static int display_arp(char *portname,USBNET_STATS *stats)
 {
 ARP_INFO *info;
+ARP_XINFO *xinfo;
 int i, rc;
 
     rc = 0;
     fprintf(report,"ARP cache\r\n");
     fprintf(report,"---------\r\n");
-    fprintf(report,"Current number of entries = %ld\r\n",stats->arp_entries);
+    fprintf(report,"Current number of entries = %ld",stats->arp_entries);
+    if (extended)
+        fprintf(report," of %ld",stats->arp_capacity);
+    if (stats->arp_capacity > 0)
+        fprintf(report," (%ld%% full)",stats->arp_entries*100/stats->arp_capacity);
+    fprintf(report,"\r\n");
     if (stats->arp_entries > 0) {
         rc = -1;
-        arp = calloc(stats->arp_entries,sizeof(ARP_INFO));
+        arp = calloc(stats->arp_entries,sizeof(ARP_XINFO));  /* also big enough for ARP_INFO */
         if (arp) {
-            rc = cntrl_port(portname,(long)arp,CTL_ETHER_GET_ARPTABLE);
-            if (rc == 0) {
-                for (i = 0, info = arp; i < stats->arp_entries; i++, info++)
-                    if (info->ip_addr)
-                        fprintf(report,"IP = %03ld.%03ld.%03ld.%03ld  MAC = %s\r\n",
-                                info->ip_addr>>24,(info->ip_addr>>16)&0xff,(info->ip_addr>>8)&0xff,info->ip_addr&0xff,
-                                format_macaddr(info->ether));
-            } else fprintf(report,"Cannot get ARP cache table\r\n");
+            if (extended) {
+                rc = cntrl_port(portname,(long)arp,CTL_ETHER_GET_XARPTABLE);
+                if (rc == 0)
+                    for (i = 0, xinfo = arp; i < stats->arp_entries; i++, xinfo++)
+                        if (xinfo->ip_addr)
+                            fprintf(report,"IP = %03ld.%03ld.%03ld.%03ld  MAC = %s  age = %5lds%s\r\n",
+                                    xinfo->ip_addr>>24,(xinfo->ip_addr>>16)&0xff,(xinfo->ip_addr>>8)&0xff,xinfo->ip_addr&0xff,
+                                    format_macaddr(xinfo->ether),xinfo->age,
+                                    (xinfo->flags&ARP_INFO_PINNED)?"  (pinned)":"");
+            } else {
+                rc = cntrl_port(portname,(long)arp,CTL_ETHER_GET_ARPTABLE);
+                if (rc == 0)
+                    for (i = 0, info = (ARP_INFO *)arp; i < stats->arp_entries; i++, info++)
+                        if (info->ip_addr)
+                            fprintf(report,"IP = %03ld.%03ld.%03ld.%03ld  MAC = %s\r\n",
+                                    info->ip_addr>>24,(info->ip_addr>>16)&0xff,(info->ip_addr>>8)&0xff,info->ip_addr&0xff,
+                                    format_macaddr(info->ether));
+            }
+            if (rc != 0)
+                fprintf(report,"Cannot get ARP cache table\r\n");
             free(arp);
         } else fprintf(report,"Cannot allocate memory for ARP cache table");
     }
@@ -203,7 +251,10 @@ long n;
     fprintf(report,"%s statistics\r\n",portname);
     fprintf(report,"--------------------\r\n");
 
-    fprintf(report,"  Driver version %s\r\n\r\n",driver_version);
+    fprintf(report,"  Driver version %s\r\n",driver_version);
+    if (!extended)
+        fprintf(report,"  (version %s or later is needed for the extended statistics)\r\n",DRIVER_VERSION);
+    fprintf(report,"\r\n");
 
     fprintf(report,"  Default MAC address: %s\r\n",format_macaddr(stats->hwaddr));
     fprintf(report,"  Current MAC address: %s\r\n\r\n",format_macaddr(stats->macaddr));
@@ -250,10 +301,196 @@ long n;
     fprintf(report,"    %7ld ARP requests received, %ld ARP answers received\r\n",stats->arp.requests_received,stats->arp.answers_received);
     fprintf(report,"    %7ld packets queued, %ld dequeued, %ld requeued (waiting for ARP)\r\n",
             stats->arp.wait_queued,stats->arp.wait_dequeued,stats->arp.wait_requeued);
-    n = stats->arp.wait_queued + stats->arp.wait_requeued - stats->arp.wait_dequeued;
-    if (n)
-        fprintf(report,"    *** %ld packets are currently awaiting address resolution ***\r\n",n);
+    if (!extended) {                    /* that is all an older driver provides */
+        n = stats->arp.wait_queued + stats->arp.wait_requeued - stats->arp.wait_dequeued;
+        if (n)
+            fprintf(report,"    *** %ld packets are currently awaiting address resolution ***\r\n",n);
+        fprintf(report,"\r\n");
+        return;
+    }
+    fprintf(report,"    %7ld ARP requests sent in total, %ld of them retransmissions\r\n",
+            stats->resolve.requests_sent,stats->resolve.retries);
+    if (stats->resolve.timeouts)
+        fprintf(report,"    *** %ld destinations did not answer, %ld packets rejected as unreachable ***\r\n",
+                stats->resolve.timeouts,stats->resolve.negative_hits);
+    fprintf(report,"    %7ld ARP cache entries expired, %ld evicted, %ld refreshed\r\n",
+            stats->resolve.cache_expired,stats->resolve.cache_evicted,stats->resolve.cache_refreshes);
+    n = stats->resolve.cache_lookups - stats->resolve.cache_fast_hits;
+    fprintf(report,"    %7ld ARP cache lookups, %ld satisfied by last entry found",
+            stats->resolve.cache_lookups,stats->resolve.cache_fast_hits);
+    if (n > 0)
+        fprintf(report,", %ld.%02ld entries examined by others",
+                stats->resolve.cache_probes/n,(stats->resolve.cache_probes%n)*100/n);
+    fprintf(report,"\r\n");
+    fprintf(report,"    %7ld gratuitous ARPs sent, %ld gateways resolved in advance\r\n",
+            stats->resolve.gratuitous,stats->resolve.gateway_probes);
+    if (stats->resolve.pending_evicted)
+        fprintf(report,"    *** %ld destinations evicted from full pending table ***\r\n",stats->resolve.pending_evicted);
+    if (stats->queue.arpwait)           /* wait_dequeued misses dgrams dropped by timeouts etc */
+        fprintf(report,"    *** %ld packets are currently awaiting address resolution ***\r\n",stats->queue.arpwait);
+
+    fprintf(report,"  USB transfers:\r\n");
+    fprintf(report,"    %7ld bulk-in transfers (%ld empty), %ld bytes\r\n",
+            stats->usb.bulk_in,stats->usb.bulk_in_empty,stats->usb.bulk_in_bytes);
+    fprintf(report,"    %7ld bulk-out transfers, %ld bytes\r\n",
+            stats->usb.bulk_out,stats->usb.bulk_out_bytes);
+    if (stats->usb.bulk_errors)
+        fprintf(report,"    *** %ld bulk transfers failed ***\r\n",stats->usb.bulk_errors);
+    fprintf(report,"    %7ld bulk-in transfers skipped while link was down\r\n",stats->usb.bulk_in_skipped);
+    fprintf(report,"    %7ld link status transfers, %ld link state changes\r\n",
+            stats->usb.int_in,stats->usb.link_changes);
+    if (stats->usb.int_errors)
+        fprintf(report,"    *** %ld link status transfers failed ***\r\n",stats->usb.int_errors);
+    n = stats->usb.bulk_in - stats->usb.bulk_in_empty;
+    if (n > 0)
+        fprintf(report,"    %7ld.%02ld packets per non-empty bulk-in transfer\r\n",
+                stats->receive.total_packets/n,(stats->receive.total_packets%n)*100/n);
+    n = stats->usb.bulk_out;
+    if (n > 0)
+        fprintf(report,"    %7ld.%02ld packets per bulk-out transfer\r\n",
+                stats->write.total_packets/n,(stats->write.total_packets%n)*100/n);
+    fprintf(report,"    %7ld packets wrapped in receive buffer\r\n",stats->framing.wrapped);
+    if (stats->framing.resets)
+        fprintf(report,"    *** %ld receive buffer resets after framing errors ***\r\n",stats->framing.resets);
+    if (stats->framing.resyncs)
+        fprintf(report,"    *** %ld attempts to resynchronise on packet header ***\r\n",stats->framing.resyncs);
+
+    fprintf(report,"  Receive polling:\r\n");
+    fprintf(report,"    %7ld polls found nothing, %ld polls skipped while idle\r\n",
+            stats->poll.empty,stats->poll.skipped);
+    fprintf(report,"    %7ld ms between reads currently (max %ld ms)\r\n",
+            stats->poll.interval,stats->poll.max_interval);
+    fprintf(report,"    %7ld polls stopped at packet/byte limit\r\n",
+            stats->poll.budget_exhausted);
+
+    fprintf(report,"  STinG memory & queues:\r\n");
+    fprintf(report,"    %7ld blocks allocated (%ld bytes), %ld dgrams discarded\r\n",
+            stats->memory.allocs,stats->memory.alloc_bytes,stats->memory.discards);
+    if (stats->memory.alloc_failures)
+        fprintf(report,"    *** %ld allocations failed ***\r\n",stats->memory.alloc_failures);
+    fprintf(report,"    %7ld dgrams in send queue, %ld in receive queue, %ld waiting for ARP\r\n",
+            stats->queue.send,stats->queue.receive,stats->queue.arpwait);
+    fprintf(report,"    %7ld max dgrams sent per call, %ld max received before queue emptied, %ld max waiting for ARP\r\n",
+            stats->queue.send_max,stats->queue.receive_max,stats->queue.arpwait_max);
+
+    display_profile(stats);
+    fprintf(report,"\r\n");
+}
+
+/*
+ *  display per-packet costs & packet size/burst distributions
+ */
+static void display_profile(USBNET_STATS *stats)
+{
+static char *size_names[USBNET_SIZE_BUCKETS] = { "<128", "<256", "<512", "<1024", "<=1514" };
+static char *burst_names[USBNET_BURST_BUCKETS] = { "1", "2-3", "4-7", "8-15", "16-31", "32-63", "64+" };
+long packets;
+int i;
+
+    packets = stats->receive.total_packets + stats->write.total_packets;
+
+    fprintf(report,"  Performance:\r\n");
+    if (stats->profile.elapsed > 0L)
+        fprintf(report,"    %7ld packets/sec received, %ld packets/sec sent\r\n",
+                stats->receive.total_packets*10L/(stats->profile.elapsed/100L+1L),
+                stats->write.total_packets*10L/(stats->profile.elapsed/100L+1L));
+    if (packets > 0L)
+        fprintf(report,"    %7ld bytes copied/packet, %ld allocs/packet, %ld.%02ld USB transfers/packet\r\n",
+                stats->profile.copied_bytes/packets,stats->memory.allocs/packets,
+                (stats->usb.bulk_in+stats->usb.bulk_out)/packets,
+                ((stats->usb.bulk_in+stats->usb.bulk_out)%packets)*100L/packets);
+    fprintf(report,"    packet size   ");
+    for (i = 0; i < USBNET_SIZE_BUCKETS; i++)
+        fprintf(report,"%8s",size_names[i]);
+    fprintf(report,"\r\n      received    ");
+    for (i = 0; i < USBNET_SIZE_BUCKETS; i++)
+        fprintf(report,"%8ld",stats->profile.rx_size[i]);
+    fprintf(report,"\r\n      sent        ");
+    for (i = 0; i < USBNET_SIZE_BUCKETS; i++)
+        fprintf(report,"%8ld",stats->profile.tx_size[i]);
+    fprintf(report,"\r\n    packets/call  ");
+    for (i = 0; i < USBNET_BURST_BUCKETS; i++)
+        fprintf(report,"%8s",burst_names[i]);
+    fprintf(report,"\r\n      received    ");
+    for (i = 0; i < USBNET_BURST_BUCKETS; i++)
+        fprintf(report,"%8ld",stats->profile.rx_burst[i]);
+    fprintf(report,"\r\n      sent        ");
+    for (i = 0; i < USBNET_BURST_BUCKETS; i++)
+        fprintf(report,"%8ld",stats->profile.tx_burst[i]);
+    fprintf(report,"\r\n    packets/transfer\r\n      sent        ");
+    for (i = 0; i < USBNET_BURST_BUCKETS; i++)
+        fprintf(report,"%8ld",stats->profile.tx_batch[i]);
     fprintf(report,"\r\n");
+
+    if (!stats->ticks.hz)               /* driver was built without PROFILE */
+        return;
+
+    fprintf(report,"    time/call (usec):\r\n");
+    display_time("read_device()",stats->ticks.read,stats->read.total_packets);
+    display_time("process_ip()",stats->ticks.ip,stats->process.normal_ip_packets);
+    display_time("receive_dgrams() per packet",stats->ticks.receive,stats->receive.total_packets);
+    display_time("process_output()",stats->ticks.output,stats->send.dequeued);
+    display_time("write_device()",stats->ticks.write,stats->write.total_packets);
+    display_time("send_dgrams() per packet",stats->ticks.send,stats->send.dequeued);
+}
+
+/*
+ *  display average time per call, given total timer C counts (of 625/24
+ *  usecs each) & number of calls
+ */
+static void display_time(char *name,long ticks,long calls)
+{
+long usecs;
+
+    if (calls <= 0L)
+        return;
+
+    usecs = ((ticks / calls) * 625L + ((ticks % calls) * 25L / calls) * 25L) / 24L;
+    fprintf(report,"      %-28s %7ld\r\n",name,usecs);
+}
+
+/*
+ *  display performance counters in CSV format, for tracking across releases
+ */
+static void display_csv(USBNET_STATS *stats)
+{
+int i;
+
+    fprintf(report,"version,date,elapsed_ms,rx_packets,tx_packets,bulk_in,bulk_in_empty,bulk_in_bytes,"
+                   "bulk_out,bulk_out_bytes,bulk_in_skipped,int_in,empty_polls,skipped_polls,budget_exhausted,allocs,alloc_bytes,copied_bytes,send_max,receive_max,arpwait_max");
+    for (i = 0; i < USBNET_SIZE_BUCKETS; i++)
+        fprintf(report,",rx_size%d",i);
+    for (i = 0; i < USBNET_SIZE_BUCKETS; i++)
+        fprintf(report,",tx_size%d",i);
+    for (i = 0; i < USBNET_BURST_BUCKETS; i++)
+        fprintf(report,",rx_burst%d",i);
+    for (i = 0; i < USBNET_BURST_BUCKETS; i++)
+        fprintf(report,",tx_burst%d",i);
+    for (i = 0; i < USBNET_BURST_BUCKETS; i++)
+        fprintf(report,",tx_batch%d",i);
+    fprintf(report,",receive_ticks,send_ticks,read_ticks,write_ticks,ip_ticks,output_ticks\r\n");
+
+    fprintf(report,"%s,%04d-%02d-%02d",driver_version,
+            ((driver_date>>9)&0x7f)+1980,(driver_date>>5)&0x0f,driver_date&0x1f);
+    fprintf(report,",%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld",
+            stats->profile.elapsed,stats->receive.total_packets,stats->write.total_packets,
+            stats->usb.bulk_in,stats->usb.bulk_in_empty,stats->usb.bulk_in_bytes,
+            stats->usb.bulk_out,stats->usb.bulk_out_bytes,stats->usb.bulk_in_skipped,stats->usb.int_in,
+            stats->poll.empty,stats->poll.skipped,stats->poll.budget_exhausted,
+            stats->memory.allocs,stats->memory.alloc_bytes,stats->profile.copied_bytes,
+            stats->queue.send_max,stats->queue.receive_max,stats->queue.arpwait_max);
+    for (i = 0; i < USBNET_SIZE_BUCKETS; i++)
+        fprintf(report,",%ld",stats->profile.rx_size[i]);
+    for (i = 0; i < USBNET_SIZE_BUCKETS; i++)
+        fprintf(report,",%ld",stats->profile.tx_size[i]);
+    for (i = 0; i < USBNET_BURST_BUCKETS; i++)
+        fprintf(report,",%ld",stats->profile.rx_burst[i]);
+    for (i = 0; i < USBNET_BURST_BUCKETS; i++)
+        fprintf(report,",%ld",stats->profile.tx_burst[i]);
+    for (i = 0; i < USBNET_BURST_BUCKETS; i++)
+        fprintf(report,",%ld",stats->profile.tx_batch[i]);
+    fprintf(report,",%ld,%ld,%ld,%ld,%ld,%ld\r\n",stats->ticks.receive,stats->ticks.send,
+            stats->ticks.read,stats->ticks.write,stats->ticks.ip,stats->ticks.output);
 }
 
 static int display_trace(char *portname,USBNET_STATS *stats)
@@ -310,13 +547,14 @@ static void quit(char *s)
 
 static void usage(void)
 {
-    fprintf(stderr,"uatool [-c[a][t]] [filename]\r\n");
+    fprintf(stderr,"uatool [-c[a][t]] [-s] [filename]\r\n");
     fprintf(stderr,"   default: report statistics plus ARP cache contents\r\n");
     fprintf(stderr,"            (plus trace if active)\r\n");
     fprintf(stderr,"   -c   clears the statistics counters instead\r\n");
     fprintf(stderr,"   -ca  clears counters & arp cache\r\n");
     fprintf(stderr,"   -ct  clears counters & trace\r\n");
     fprintf(stderr,"   -cat clears everything\r\n");
+    fprintf(stderr,"   -s   reports performance counters in CSV format\r\n");
     fprintf(stderr,"   output is to stdout, unless a filename is present, in\r\n");
     fprintf(stderr,"   which case all output will be written to it instead\r\n");
     quit(NULL);